@@ -13,12 +13,15 @@ void Basis::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(
              group, "type", tangentspace->project.lock()->enumtype) == "Basis");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "tangentspace", "name") ==
-         tangentspace->name);
+  const bool lean =
+      tangentspace->project.lock()->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "tangentspace",
+                                                "name") == tangentspace->name);
   configuration = tangentspace->project.lock()->configurations.at(
       H5::readGroupAttribute<string>(group, "configuration", "name"));
-  assert(H5::readGroupAttribute<string>(
-             group, string("configuration/bases/") + name, "name") == name);
+  assert(lean || H5::readGroupAttribute<string>(
+                     group, string("configuration/bases/") + name, "name") ==
+                     name);
   H5::readGroup(group, "basisvectors",
                 [&](const H5::Group &group, const string &name) {
                   readBasisVector(group, name);
@@ -37,27 +40,47 @@ ostream &Basis::output(ostream &os, int level) const {
 }
 
 void Basis::write(const H5::CommonFG &loc, const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type",
                       tangentspace.lock()->project.lock()->enumtype, "Basis");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "tangentspace", parent, ".");
-  H5::createHardLink(group, "configuration", parent,
-                     string("project/configurations/") + configuration->name);
-  H5::createHardLink(group, string("tangentspace/project/configurations/") +
-                                configuration->name + "/bases",
-                     name, group, ".");
+  const auto &project = tangentspace.lock()->project.lock();
+  if (project->layout == Project::layout_lean) {
+    H5::createHardLink(group, "configuration", project->location,
+                       string("configurations/") + configuration->name);
+  } else {
+    H5::createHardLink(group, "tangentspace", parent, ".");
+    H5::createHardLink(group, "configuration", parent,
+                       string("project/configurations/") + configuration->name);
+    H5::createHardLink(group, string("tangentspace/project/configurations/") +
+                                  configuration->name + "/bases",
+                       name, group, ".");
+  }
   H5::createGroup(group, "basisvectors", basisvectors);
 #warning "TODO: output directions"
 }
 
+void Basis::append(const H5::CommonFG &loc,
+                   const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "basisvectors", basisvectors);
+}
+
+string Basis::getPath() const {
+  return tangentspace.lock()->getPath() + "/bases/" + name;
+}
+
 shared_ptr<BasisVector> Basis::createBasisVector(const string &name,
                                                  int direction) {
   auto basisvector = BasisVector::create(name, shared_from_this(), direction);
   checked_emplace(basisvectors, basisvector->name, basisvector);
+  tangentspace.lock()->project.lock()->insertPath(*this, "basisvectors",
+                                                  basisvector);
   checked_emplace(directions, basisvector->direction, basisvector);
-  assert(basisvector->invariant());
+  basisvector->markDirty();
+  assert(basisvector->checkInvariant());
   return basisvector;
 }
 
@@ -65,8 +88,10 @@ shared_ptr<BasisVector> Basis::readBasisVector(const H5::CommonFG &loc,
                                                const string &entry) {
   auto basisvector = BasisVector::create(loc, entry, shared_from_this());
   checked_emplace(basisvectors, basisvector->name, basisvector);
+  tangentspace.lock()->project.lock()->insertPath(*this, "basisvectors",
+                                                  basisvector);
   checked_emplace(directions, basisvector->direction, basisvector);
-  assert(basisvector->invariant());
+  assert(basisvector->checkInvariant());
   return basisvector;
 }
 }
@@ -33,6 +33,10 @@ struct Basis : Common, std::enable_shared_from_this<Basis> {
   NoBackLink<weak_ptr<DiscreteField>> discretefields;
   // map<string, CoordinateBasis *> coordinatebases;
 
+  virtual shared_ptr<const Common> getParent() const {
+    return tangentspace.lock();
+  }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(tangentspace.lock()) &&
            tangentspace.lock()->bases.count(name) &&
@@ -85,6 +89,9 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<BasisVector> createBasisVector(const string &name, int direction);
   shared_ptr<BasisVector> readBasisVector(const H5::CommonFG &loc,
@@ -13,7 +13,9 @@ void BasisVector::read(const H5::CommonFG &loc, const string &entry,
              basis->tangentspace.lock()->project.lock()->enumtype) ==
          "BasisVector");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "basis", "name") == basis->name);
+  assert(basis->tangentspace.lock()->project.lock()->layout ==
+             Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "basis", "name") == basis->name);
   H5::readAttribute(group, "direction", direction);
 }
 
@@ -25,14 +27,16 @@ ostream &BasisVector::output(ostream &os, int level) const {
 
 void BasisVector::write(const H5::CommonFG &loc,
                         const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(
       group, "type",
       basis.lock()->tangentspace.lock()->project.lock()->enumtype,
       "BasisVector");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "basis", parent, ".");
+  if (basis.lock()->tangentspace.lock()->project.lock()->layout ==
+      Project::layout_full)
+    H5::createHardLink(group, "basis", parent, ".");
   H5::createAttribute(group, "direction", direction);
 }
 }
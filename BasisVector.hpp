@@ -22,6 +22,8 @@ struct BasisVector : Common, std::enable_shared_from_this<BasisVector> {
   weak_ptr<Basis> basis; // parent
   int direction;
 
+  virtual shared_ptr<const Common> getParent() const { return basis.lock(); }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(basis.lock()) &&
            basis.lock()->basisvectors.count(name) &&
@@ -4,11 +4,13 @@
 #include <H5Cpp.h>
 
 #include <iostream>
+#include <memory>
 #include <string>
 
 namespace SimulationIO {
 
 using std::ostream;
+using std::shared_ptr;
 using std::string;
 
 // C++ make_shared requires constructors to be public; we add a field of type
@@ -38,22 +40,69 @@ template <typename T> struct NoBackLink {
   bool nobacklink() const { return true; }
 };
 
+// Invariant checking: Entities check their invariants whenever they are
+// created, read, or written. Local invariants examine only an entity and its
+// direct links, and take O(1) time (up to map lookups). Full invariants also
+// examine all children and siblings; checking them on every insertion makes
+// building large projects quadratic. Project::validate checks the full
+// invariants of all entities, independent of the invariant level.
+enum invariant_level_t { invariant_none, invariant_local, invariant_full };
+
+#ifndef SIMULATIONIO_INVARIANT_LEVEL
+#define SIMULATIONIO_INVARIANT_LEVEL invariant_local
+#endif
+
+// The invariant level can be changed at run time
+inline invariant_level_t &invariant_level() {
+  static invariant_level_t level = SIMULATIONIO_INVARIANT_LEVEL;
+  return level;
+}
+
 // Common to all file elements
 
 struct Common {
   string name;
 
+  // Whether this entity, or any entity it contains, has been created or
+  // modified since it was last written or read
+  mutable bool dirty;
+  // Mark this entity and the entities containing it as dirty
+  void markDirty() const {
+    for (const Common *entity = this; entity && !entity->dirty;
+         entity = entity->getParent().get())
+      entity->dirty = true;
+  }
+  // The entity containing this one, or null for the project
+  virtual shared_ptr<const Common> getParent() const { return nullptr; }
+
   virtual bool invariant() const { return !name.empty(); }
+  virtual bool fullInvariant() const { return invariant(); }
+  bool checkInvariant() const {
+    switch (invariant_level()) {
+    case invariant_none:
+      return true;
+    case invariant_local:
+      return invariant();
+    case invariant_full:
+      return fullInvariant();
+    }
+    return false;
+  }
 
 protected:
-  Common(const string &name) : name(name) {}
-  Common(hidden) {}
+  Common(const string &name) : name(name), dirty(false) {}
+  Common(hidden) : dirty(false) {}
 
 public:
   virtual ~Common() {}
   virtual ostream &output(ostream &os, int level = 0) const = 0;
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const = 0;
+  // Write those children that are not yet present in an entity that has
+  // already been written, and update the parts of the entity that may have
+  // been modified since. Only dirty entities are appended.
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const {}
 
   // The association between names and integer values below MUST NOT BE
   // MODIFIED, except that new integer values may be added.
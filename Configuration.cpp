@@ -20,17 +20,19 @@ void Configuration::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(group, "type", project->enumtype) ==
          "Configuration");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "project", "name") ==
-         project->name);
+  const bool lean = project->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "project", "name") ==
+                     project->name);
   H5::readGroup(group, "parametervalues", [&](const H5::Group &group,
                                               const string &valname) {
     auto parname =
         H5::readGroupAttribute<string>(group, valname + "/parameter", "name");
     auto parameter = project->parameters.at(parname);
     auto parametervalue = parameter->parametervalues.at(valname);
-    assert(H5::readGroupAttribute<string>(
+    assert(lean ||
+           H5::readGroupAttribute<string>(
                group, valname + string("/configurations/") + name, "name") ==
-           name);
+               name);
     insertParameterValue(parametervalue);
   });
   // Cannot check "bases", "coordinatesystems", "discretefields",
@@ -75,25 +77,18 @@ ostream &Configuration::output(ostream &os, int level) const {
 
 void Configuration::write(const H5::CommonFG &loc,
                           const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", project.lock()->enumtype, "Configuration");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "project", parent, ".");
-  auto val_group = group.createGroup("parametervalues");
-  for (const auto &val : parametervalues) {
-    H5::createHardLink(val_group, val.second->name, parent,
-                       string("parameters/") +
-                           val.second->parameter.lock()->name +
-                           "/parametervalues/" + val.second->name);
-    H5::createHardLink(group, string("project/parameters/") +
-                                  val.second->parameter.lock()->name +
-                                  "/parametervalues/" + val.second->name +
-                                  "/configurations",
-                       name, group, ".");
-    // TODO: Create soft links instead of hard links to avoid
-    // confusion when reading HDF5 files
-  }
+  const bool lean = project.lock()->layout == Project::layout_lean;
+  if (!lean)
+    H5::createHardLink(group, "project", parent, ".");
+  group.createGroup("parametervalues");
+  for (const auto &val : parametervalues)
+    writeParameterValue(group, parent, *val.second);
+  if (lean)
+    return;
   group.createGroup("bases");
   group.createGroup("coordinatesystems");
   group.createGroup("discretefields");
@@ -110,5 +105,34 @@ void Configuration::insertParameterValue(
            parametervalue->parameter.lock().get());
   checked_emplace(parametervalues, parametervalue->name, parametervalue);
   parametervalue->insert(shared_from_this());
+  markDirty();
+}
+
+void Configuration::writeParameterValue(
+    const H5::Group &group, const H5::H5Location &parent,
+    const ParameterValue &parametervalue) const {
+  const bool lean = project.lock()->layout == Project::layout_lean;
+  H5::createHardLink(group, string("parametervalues/") + parametervalue.name,
+                     parent, string("parameters/") +
+                                 parametervalue.parameter.lock()->name +
+                                 "/parametervalues/" + parametervalue.name);
+  if (!lean)
+    H5::createHardLink(group, string("project/parameters/") +
+                                  parametervalue.parameter.lock()->name +
+                                  "/parametervalues/" + parametervalue.name +
+                                  "/configurations",
+                       name, group, ".");
+  // TODO: Create soft links instead of hard links to avoid
+  // confusion when reading HDF5 files
+}
+
+void Configuration::append(const H5::CommonFG &loc,
+                           const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  // Parameter values may have been inserted
+  for (const auto &val : parametervalues)
+    if (!H5::pathExists(group, string("parametervalues/") + val.second->name))
+      writeParameterValue(group, parent, *val.second);
 }
 }
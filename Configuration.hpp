@@ -41,6 +41,8 @@ struct Configuration : Common, std::enable_shared_from_this<Configuration> {
   map<string, weak_ptr<Manifold>> manifolds;                 // backlinks
   map<string, weak_ptr<TangentSpace>> tangentspaces;         // backlinks
 
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(project.lock()) &&
            project.lock()->configurations.count(name) &&
@@ -82,10 +84,16 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
 
   void insertParameterValue(const shared_ptr<ParameterValue> &parametervalue);
 
 private:
+  void writeParameterValue(const H5::Group &group,
+                           const H5::H5Location &parent,
+                           const ParameterValue &parametervalue) const;
+
   friend struct Basis;
   friend struct CoordinateSystem;
   friend struct DiscreteField;
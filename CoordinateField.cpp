@@ -17,8 +17,9 @@ void CoordinateField::read(
              coordinatesystem->manifold->project.lock()->enumtype) ==
          "CoordinateField");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "coordinatesystem", "name") ==
-         coordinatesystem->name);
+  assert(coordinatesystem->project.lock()->layout == Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "coordinatesystem", "name") ==
+             coordinatesystem->name);
   H5::readAttribute(group, "direction", direction);
   field = coordinatesystem->manifold->project.lock()->fields.at(
       H5::readGroupAttribute<string>(group, "field", "name"));
@@ -34,16 +35,22 @@ ostream &CoordinateField::output(ostream &os, int level) const {
 
 void CoordinateField::write(const H5::CommonFG &loc,
                             const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(
       group, "type",
       coordinatesystem.lock()->manifold->project.lock()->enumtype,
       "CoordinateField");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "coordinatesystem", parent, ".");
+  const auto &project = coordinatesystem.lock()->project.lock();
+  if (project->layout == Project::layout_full)
+    H5::createHardLink(group, "coordinatesystem", parent, ".");
   H5::createAttribute(group, "direction", direction);
-  H5::createHardLink(group, "field", parent,
-                     string("project/fields/") + field->name);
+  if (project->layout == Project::layout_lean)
+    H5::createHardLink(group, "field", project->location,
+                       string("fields/") + field->name);
+  else
+    H5::createHardLink(group, "field", parent,
+                       string("project/fields/") + field->name);
 }
 }
@@ -24,6 +24,10 @@ struct CoordinateField : Common, std::enable_shared_from_this<CoordinateField> {
   int direction;
   shared_ptr<Field> field; // no backlink
 
+  virtual shared_ptr<const Common> getParent() const {
+    return coordinatesystem.lock();
+  }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(coordinatesystem.lock()) &&
            coordinatesystem.lock()->coordinatefields.count(name) &&
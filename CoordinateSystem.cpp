@@ -13,15 +13,16 @@ void CoordinateSystem::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(group, "type", project->enumtype) ==
          "CoordinateSystem");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "project", "name") ==
-         project->name);
+  const bool lean = project->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "project", "name") ==
+                     project->name);
   configuration = project->configurations.at(
       H5::readGroupAttribute<string>(group, "configuration", "name"));
   manifold = project->manifolds.at(
       H5::readGroupAttribute<string>(group, "manifold", "name"));
-  assert(H5::readGroupAttribute<string>(
-             group, string("project/coordinatesystems/") + name, "name") ==
-         name);
+  assert(lean || H5::readGroupAttribute<string>(
+                     group, string("project/coordinatesystems/") + name,
+                     "name") == name);
   H5::readGroup(group, "coordinatefields",
                 [&](const H5::Group &group, const string &name) {
                   readCoordinateField(group, name);
@@ -43,34 +44,49 @@ ostream &CoordinateSystem::output(ostream &os, int level) const {
 
 void CoordinateSystem::write(const H5::CommonFG &loc,
                              const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", project.lock()->enumtype,
                       "CoordinateSystem");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "project", parent, ".");
   H5::createHardLink(group, "configuration", parent,
                      string("configurations/") + configuration->name);
-  H5::createHardLink(group, string("project/configurations/") +
-                                configuration->name + "/coordinatesystems",
-                     name, group, ".");
   H5::createHardLink(group, "manifold", parent,
                      string("manifolds/") + manifold->name);
-  H5::createHardLink(group, string("project/manifolds/") + manifold->name +
-                                "/coordinatesystems",
-                     name, group, ".");
+  if (project.lock()->layout == Project::layout_full) {
+    H5::createHardLink(group, "project", parent, ".");
+    H5::createHardLink(group, string("project/configurations/") +
+                                  configuration->name + "/coordinatesystems",
+                       name, group, ".");
+    H5::createHardLink(group, string("project/manifolds/") + manifold->name +
+                                  "/coordinatesystems",
+                       name, group, ".");
+  }
   H5::createGroup(group, "coordinatefields", coordinatefields);
 #warning "TODO: output directions"
 }
 
+void CoordinateSystem::append(const H5::CommonFG &loc,
+                              const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "coordinatefields", coordinatefields);
+}
+
+string CoordinateSystem::getPath() const {
+  return string("coordinatesystems/") + name;
+}
+
 shared_ptr<CoordinateField>
 CoordinateSystem::createCoordinateField(const string &name, int direction,
                                         const shared_ptr<Field> &field) {
   auto coordinatefield =
       CoordinateField::create(name, shared_from_this(), direction, field);
   checked_emplace(coordinatefields, coordinatefield->name, coordinatefield);
+  project.lock()->insertPath(*this, "coordinatefields", coordinatefield);
   checked_emplace(directions, coordinatefield->direction, coordinatefield);
-  assert(coordinatefield->invariant());
+  coordinatefield->markDirty();
+  assert(coordinatefield->checkInvariant());
   return coordinatefield;
 }
 
@@ -80,8 +96,9 @@ CoordinateSystem::readCoordinateField(const H5::CommonFG &loc,
   auto coordinatefield =
       CoordinateField::create(loc, entry, shared_from_this());
   checked_emplace(coordinatefields, coordinatefield->name, coordinatefield);
+  project.lock()->insertPath(*this, "coordinatefields", coordinatefield);
   checked_emplace(directions, coordinatefield->direction, coordinatefield);
-  assert(coordinatefield->invariant());
+  assert(coordinatefield->checkInvariant());
   return coordinatefield;
 }
 }
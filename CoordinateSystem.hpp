@@ -32,6 +32,8 @@ struct CoordinateSystem : Common,
   map<int, shared_ptr<CoordinateField>> directions;
   // map<string, shared_ptr<CoordinateBasis>> coordinatebases;
 
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(project.lock()) &&
            project.lock()->coordinatesystems.count(name) &&
@@ -89,6 +91,9 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<CoordinateField>
   createCoordinateField(const string &name, int direction,
@@ -0,0 +1,145 @@
+#include "DataCopy.hpp"
+
+#include "DiscreteFieldBlock.hpp"
+#include "H5Helpers.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+
+namespace SimulationIO {
+
+namespace {
+// The active part of a block that lies in dest
+region_t overlap(const box_t &region, const region_t &active,
+                 const box_t &dest) {
+  assert(region.valid() && region.rank() == dest.rank());
+  const region_t source = active.valid() ? active & region : region_t(region);
+  return source & dest;
+}
+
+// Copy the points of a box from one block to another in contiguous runs
+template <typename T> struct copy_box {
+  const box_t &source_region;
+  const T *source_data;
+  const box_t &dest_region;
+  T *dest_data;
+  template <int D>
+  void operator()(const RegionCalculus::box<hssize_t, D> &b) const {
+    const auto source_box = source_region.get<D>();
+    const auto dest_box = dest_region.get<D>();
+    RegionCalculus::for_each_run(
+        b, source_box, [&](const RegionCalculus::point<hssize_t, D> &p,
+                           std::ptrdiff_t idx, hssize_t n) {
+          std::memcpy(dest_data + RegionCalculus::linear_index(p, dest_box),
+                      source_data + idx, n * sizeof(T));
+        });
+  }
+};
+
+// HDF5 stores direction 0 last
+vector<hsize_t> hdf5_vector(const point_t &p) {
+  vector<hssize_t> v(p);
+  std::reverse(v.begin(), v.end());
+  return vector<hsize_t>(v.begin(), v.end());
+}
+}
+
+template <typename T>
+void copyData(const vector<BlockData<T>> &sources, const box_t &dest,
+              T *dest_data, bool parallel) {
+  assert(dest.valid());
+  const auto copy_sources = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const auto &source = sources[i];
+      for (const auto &b :
+           vector<box_t>(overlap(source.region, source.active, dest)))
+        b.visit(copy_box<T>{source.region, source.data, dest, dest_data});
+    }
+  };
+  const std::size_t nsources = sources.size();
+  const std::size_t max_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  const std::size_t nthreads =
+      !parallel ? 1 : std::min(max_threads, std::max(std::size_t(1), nsources));
+  if (nthreads == 1) {
+    copy_sources(0, nsources);
+    return;
+  }
+  vector<std::future<void>> futures;
+  for (std::size_t n = 0; n < nthreads; ++n)
+    futures.push_back(std::async(std::launch::async, copy_sources,
+                                 n * nsources / nthreads,
+                                 (n + 1) * nsources / nthreads));
+  for (auto &future : futures)
+    future.get();
+}
+
+template <typename T>
+void copyData(
+    const vector<shared_ptr<DiscreteFieldBlockComponent>> &sources,
+    const box_t &dest, T *dest_data) {
+  assert(dest.valid());
+  if (dest.empty())
+    return;
+  const int dim = dest.rank();
+  const auto dest_shape = hdf5_vector(dest.shape());
+  auto memspace = H5::DataSpace(dim, dest_shape.data());
+  for (const auto &source : sources) {
+    // Only datasets can be read from; split output is read back as external
+    // links to the data files. Other sources are skipped.
+    if (source->data_type != DiscreteFieldBlockComponent::type_dataset &&
+        source->data_type != DiscreteFieldBlockComponent::type_extlink)
+      continue;
+    const auto &block = source->discretefieldblock.lock()->discretizationblock;
+    const auto region = overlap(block->region, block->active, dest);
+    if (region.empty())
+      continue;
+    const auto dataset = source->getDataSet();
+    auto filespace = source->getDataSpace();
+    assert(filespace.getSimpleExtentNdims() == dim);
+    const auto read_boxes = [&](const vector<box_t> &boxes) {
+      // The file and memory selections are offset by the same amount, so
+      // that HDF5 traverses their points in the same order
+      filespace.selectNone();
+      memspace.selectNone();
+      for (const auto &b : boxes) {
+        const auto count = hdf5_vector(b.shape());
+        const auto file_start = hdf5_vector(b.lower() - block->region.lower());
+        const auto mem_start = hdf5_vector(b.lower() - dest.lower());
+        filespace.selectHyperslab(H5S_SELECT_OR, count.data(),
+                                  file_start.data());
+        memspace.selectHyperslab(H5S_SELECT_OR, count.data(),
+                                 mem_start.data());
+      }
+      dataset.read(dest_data, H5::getType(T()), memspace, filespace);
+    };
+    // Read chunked datasets one chunk at a time, so that each chunk is
+    // decompressed once and the selections remain small
+    const auto proplist = dataset.getCreatePlist();
+    if (proplist.getLayout() == H5D_CHUNKED) {
+      vector<hsize_t> chunk_dims(dim);
+      proplist.getChunk(dim, chunk_dims.data());
+      const point_t chunk_shape(
+          vector<hssize_t>(chunk_dims.rbegin(), chunk_dims.rend()));
+      for (const auto &chunk :
+           region.chunks(block->region.lower(), chunk_shape))
+        read_boxes(chunk.second);
+    } else {
+      read_boxes(region);
+    }
+  }
+}
+
+template void copyData(const vector<BlockData<int>> &sources,
+                       const box_t &dest, int *dest_data, bool parallel);
+template void copyData(const vector<BlockData<double>> &sources,
+                       const box_t &dest, double *dest_data, bool parallel);
+template void
+copyData(const vector<shared_ptr<DiscreteFieldBlockComponent>> &sources,
+         const box_t &dest, int *dest_data);
+template void
+copyData(const vector<shared_ptr<DiscreteFieldBlockComponent>> &sources,
+         const box_t &dest, double *dest_data);
+}
@@ -0,0 +1,64 @@
+#ifndef DATACOPY_HPP
+#define DATACOPY_HPP
+
+#include "DiscreteFieldBlockComponent.hpp"
+#include "DiscretizationBlock.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace SimulationIO {
+
+using std::shared_ptr;
+using std::vector;
+
+// Copying data between blocks. Data are stored in memory order, i.e.
+// direction 0 varies fastest. Only the points in the active region of a
+// source block (or its whole region, if no active region is set) that lie
+// in the destination box are copied; the remaining destination points are
+// left unchanged. Each box of the overlap is copied in contiguous runs.
+
+// The data of a block held in memory
+template <typename T> struct BlockData {
+  box_t region;
+  region_t active;
+  const T *data; // one value for each point of region
+};
+
+// Copy from blocks in memory. When parallel is set, the sources are split
+// among threads; their active regions should then not overlap.
+template <typename T>
+void copyData(const vector<BlockData<T>> &sources, const box_t &dest,
+              T *dest_data, bool parallel = false);
+
+// Copy from the HDF5 datasets of discrete field block components. Sources
+// are read with hyperslab selections directly into the destination, with
+// one read per touched chunk for chunked datasets. (The HDF5 library is
+// not thread-safe; sources are read one after the other.) Sources whose
+// data are not stored in a dataset (empty, range, or copy components) are
+// skipped, leaving the destination unchanged there.
+template <typename T>
+void copyData(
+    const vector<shared_ptr<DiscreteFieldBlockComponent>> &sources,
+    const box_t &dest, T *dest_data);
+
+// Copy into a block, using its region as destination box
+template <typename T>
+void copyData(const vector<BlockData<T>> &sources,
+              const shared_ptr<DiscretizationBlock> &dest, T *dest_data,
+              bool parallel = false) {
+  copyData(sources, dest->region, dest_data, parallel);
+}
+template <typename T>
+void copyData(
+    const vector<shared_ptr<DiscreteFieldBlockComponent>> &sources,
+    const shared_ptr<DiscretizationBlock> &dest, T *dest_data) {
+  copyData(sources, dest->region, dest_data);
+}
+}
+
+#define DATACOPY_HPP_DONE
+#endif // #ifndef DATACOPY_HPP
+#ifndef DATACOPY_HPP_DONE
+#error "Cyclic include depencency"
+#endif
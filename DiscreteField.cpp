@@ -1,6 +1,7 @@
 #include "DiscreteField.hpp"
 
 #include "DiscreteFieldBlock.hpp"
+#include "DiscreteFieldBlockComponent.hpp"
 
 #include "H5Helpers.hpp"
 
@@ -14,14 +15,16 @@ void DiscreteField::read(const H5::CommonFG &loc, const string &entry,
                                    field->project.lock()->enumtype) ==
          "DiscreteField");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "field", "name") == field->name);
+  const bool lean = field->project.lock()->layout == Project::layout_lean;
+  assert(lean ||
+         H5::readGroupAttribute<string>(group, "field", "name") == field->name);
   // TODO: Read and interpret objects (shallowly) instead of naively only
   // looking at their names
   configuration = field->project.lock()->configurations.at(
       H5::readGroupAttribute<string>(group, "configuration", "name"));
-  assert(H5::readGroupAttribute<string>(
-             group, string("configuration/discretefields/") + name, "name") ==
-         name);
+  assert(lean || H5::readGroupAttribute<string>(
+                     group, string("configuration/discretefields/") + name,
+                     "name") == name);
   discretization = field->manifold->discretizations.at(
       H5::readGroupAttribute<string>(group, "discretization", "name"));
   basis = field->tangentspace->bases.at(
@@ -45,25 +48,81 @@ ostream &DiscreteField::output(ostream &os, int level) const {
   return os;
 }
 
+vector<shared_ptr<DiscreteFieldBlock>>
+DiscreteField::orderedDiscreteFieldBlocks() const {
+  // Blocks without region come first, in the order of their names
+  vector<shared_ptr<DiscreteFieldBlock>> result, located;
+  vector<box_t> regions;
+  for (const auto &dfb : discretefieldblocks) {
+    const auto &region = dfb.second->discretizationblock->region;
+    if (region.valid()) {
+      located.push_back(dfb.second);
+      regions.push_back(region);
+    } else {
+      result.push_back(dfb.second);
+    }
+  }
+  for (const auto i : RegionCalculus::sfc_order(regions))
+    result.push_back(located[i]);
+  return result;
+}
+
 void DiscreteField::write(const H5::CommonFG &loc,
                           const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", field.lock()->project.lock()->enumtype,
                       "DiscreteField");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "field", parent, ".");
-  H5::createHardLink(group, "configuration", parent,
-                     string("project/configurations/") + configuration->name);
-  H5::createHardLink(group, string("field/project/configurations/") +
-                                configuration->name + "/discretefields",
-                     name, group, ".");
+  const auto &project = field.lock()->project.lock();
+  if (project->layout == Project::layout_lean) {
+    H5::createHardLink(group, "configuration", project->location,
+                       string("configurations/") + configuration->name);
+  } else {
+    H5::createHardLink(group, "field", parent, ".");
+    H5::createHardLink(group, "configuration", parent,
+                       string("project/configurations/") + configuration->name);
+    H5::createHardLink(group, string("field/project/configurations/") +
+                                  configuration->name + "/discretefields",
+                       name, group, ".");
+  }
   H5::createHardLink(group, "discretization", parent,
                      string("manifold/discretizations/") +
                          discretization->name);
   H5::createHardLink(group, "basis", parent,
                      string("tangentspace/bases/") + basis->name);
-  createGroup(group, "discretefieldblocks", discretefieldblocks);
+  createGroup(group, "discretefieldblocks", orderedDiscreteFieldBlocks());
+}
+
+void DiscreteField::append(const H5::CommonFG &loc,
+                           const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "discretefieldblocks", orderedDiscreteFieldBlocks());
+}
+
+void DiscreteField::stream() const {
+  const auto &project = field.lock()->project.lock();
+  if (!project->streaming())
+    return;
+  // Write the entities this discrete field links to if they are new
+  project->streamConfiguration(*configuration);
+  project->streamDiscretization(*discretization);
+  project->streamBasis(*basis);
+  const auto &loc = project->stream_location;
+  const auto parentpath = string("fields/") + field.lock()->name;
+  if (!H5::pathExists(loc, parentpath)) {
+    // A new field is written together with this discrete field
+    project->streamField(*field.lock());
+    return;
+  }
+  auto parent = loc.openGroup(parentpath);
+  write(parent.openGroup("discretefields"), parent);
+  dirty = false;
+}
+
+string DiscreteField::getPath() const {
+  return string("fields/") + field.lock()->name + "/discretefields/" + name;
 }
 
 shared_ptr<DiscreteFieldBlock> DiscreteField::createDiscreteFieldBlock(
@@ -73,7 +132,11 @@ shared_ptr<DiscreteFieldBlock> DiscreteField::createDiscreteFieldBlock(
       DiscreteFieldBlock::create(name, shared_from_this(), discretizationblock);
   checked_emplace(discretefieldblocks, discretefieldblock->name,
                   discretefieldblock);
-  assert(discretefieldblock->invariant());
+  field.lock()->project.lock()->insertPath(*this, "discretefieldblocks",
+                                           discretefieldblock);
+  discretefieldblock->markDirty();
+  assert(discretefieldblock->checkInvariant());
+  discretefieldblock->stream();
   return discretefieldblock;
 }
 
@@ -84,7 +147,20 @@ DiscreteField::readDiscreteFieldBlock(const H5::CommonFG &loc,
       DiscreteFieldBlock::create(loc, entry, shared_from_this());
   checked_emplace(discretefieldblocks, discretefieldblock->name,
                   discretefieldblock);
-  assert(discretefieldblock->invariant());
+  field.lock()->project.lock()->insertPath(*this, "discretefieldblocks",
+                                           discretefieldblock);
+  assert(discretefieldblock->checkInvariant());
   return discretefieldblock;
 }
+
+void DiscreteField::releaseDiscreteFieldBlock(const string &name) {
+  const auto &project = field.lock()->project.lock();
+  // Only blocks that have been written can be released
+  assert(project->streaming());
+  const auto &discretefieldblock = discretefieldblocks.at(name);
+  for (const auto &dfbd : discretefieldblock->discretefieldblockcomponents)
+    project->erasePath(dfbd.second->getPath());
+  project->erasePath(discretefieldblock->getPath());
+  discretefieldblocks.erase(name);
+}
 }
@@ -13,6 +13,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace SimulationIO {
 
@@ -21,6 +22,7 @@ using std::map;
 using std::ostream;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 
 struct DiscreteFieldBlock;
@@ -32,6 +34,8 @@ struct DiscreteField : Common, std::enable_shared_from_this<DiscreteField> {
   shared_ptr<Basis> basis;                   // with backlink
   map<string, shared_ptr<DiscreteFieldBlock>> discretefieldblocks; // children
 
+  virtual shared_ptr<const Common> getParent() const { return field.lock(); }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(field.lock()) &&
            field.lock()->discretefields.count(name) &&
@@ -81,6 +85,9 @@ private:
   }
   void read(const H5::CommonFG &loc, const string &entry,
             const shared_ptr<Field> &field);
+  // Write a newly created discrete field if the project is streaming
+  friend struct DiscreteFieldBlock;
+  void stream() const;
 
 public:
   virtual ~DiscreteField() {}
@@ -91,12 +98,24 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
+
+  // The blocks ordered along a space-filling curve through their regions,
+  // blocks without region first. Blocks are written in this order. The
+  // storage of their datasets is allocated when their data are written, so
+  // that data should be written in this order as well to place nearby
+  // blocks close to each other in the file.
+  vector<shared_ptr<DiscreteFieldBlock>> orderedDiscreteFieldBlocks() const;
 
   shared_ptr<DiscreteFieldBlock> createDiscreteFieldBlock(
       const string &name,
       const shared_ptr<DiscretizationBlock> &discretizationblock);
   shared_ptr<DiscreteFieldBlock> readDiscreteFieldBlock(const H5::CommonFG &loc,
                                                         const string &entry);
+  // Remove a block that has been written while streaming from memory
+  void releaseDiscreteFieldBlock(const string &name);
 };
 }
 
@@ -16,8 +16,10 @@ void DiscreteFieldBlock::read(const H5::CommonFG &loc, const string &entry,
              discretefield->field.lock()->project.lock()->enumtype) ==
          "DiscreteFieldBlock");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "discretefield", "name") ==
-         discretefield->name);
+  assert(discretefield->field.lock()->project.lock()->layout ==
+             Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "discretefield", "name") ==
+             discretefield->name);
   // TODO: Read and interpret objects (shallowly) instead of naively only
   // looking at their names
   discretizationblock = discretefield->discretization->discretizationblocks.at(
@@ -41,14 +43,16 @@ ostream &DiscreteFieldBlock::output(ostream &os, int level) const {
 
 void DiscreteFieldBlock::write(const H5::CommonFG &loc,
                                const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(
       group, "type",
       discretefield.lock()->field.lock()->project.lock()->enumtype,
       "DiscreteFieldBlock");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "discretefield", parent, ".");
+  if (discretefield.lock()->field.lock()->project.lock()->layout ==
+      Project::layout_full)
+    H5::createHardLink(group, "discretefield", parent, ".");
   H5::createHardLink(group, "discretizationblock", parent,
                      string("discretization/discretizationblocks/") +
                          discretizationblock->name);
@@ -57,6 +61,36 @@ void DiscreteFieldBlock::write(const H5::CommonFG &loc,
 #warning "TODO: write storage_indices"
 }
 
+void DiscreteFieldBlock::append(const H5::CommonFG &loc,
+                                const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "discretefieldblockcomponents",
+                  discretefieldblockcomponents);
+}
+
+void DiscreteFieldBlock::stream() const {
+  const auto &project = discretefield.lock()->field.lock()->project.lock();
+  if (!project->streaming())
+    return;
+  // Write the discretization block if it is new
+  project->streamDiscretizationBlock(*discretizationblock);
+  const auto &loc = project->stream_location;
+  const auto &parentpath = discretefield.lock()->getPath();
+  if (!H5::pathExists(loc, parentpath)) {
+    // The discrete field is written together with this block
+    discretefield.lock()->stream();
+    return;
+  }
+  auto parent = loc.openGroup(parentpath);
+  write(parent.openGroup("discretefieldblocks"), parent);
+  dirty = false;
+}
+
+string DiscreteFieldBlock::getPath() const {
+  return discretefield.lock()->getPath() + "/discretefieldblocks/" + name;
+}
+
 shared_ptr<DiscreteFieldBlockComponent>
 DiscreteFieldBlock::createDiscreteFieldBlockComponent(
     const string &name, const shared_ptr<TensorComponent> &tensorcomponent) {
@@ -65,10 +99,14 @@ DiscreteFieldBlock::createDiscreteFieldBlockComponent(
   checked_emplace(discretefieldblockcomponents,
                   discretefieldblockcomponent->name,
                   discretefieldblockcomponent);
+  discretefield.lock()->field.lock()->project.lock()->insertPath(
+      *this, "discretefieldblockcomponents", discretefieldblockcomponent);
   checked_emplace(storage_indices,
                   discretefieldblockcomponent->tensorcomponent->storage_index,
                   discretefieldblockcomponent);
-  assert(discretefieldblockcomponent->invariant());
+  discretefieldblockcomponent->markDirty();
+  assert(discretefieldblockcomponent->checkInvariant());
+  discretefieldblockcomponent->stream();
   return discretefieldblockcomponent;
 }
 
@@ -80,10 +118,26 @@ DiscreteFieldBlock::readDiscreteFieldBlockComponent(const H5::CommonFG &loc,
   checked_emplace(discretefieldblockcomponents,
                   discretefieldblockcomponent->name,
                   discretefieldblockcomponent);
+  discretefield.lock()->field.lock()->project.lock()->insertPath(
+      *this, "discretefieldblockcomponents", discretefieldblockcomponent);
   checked_emplace(storage_indices,
                   discretefieldblockcomponent->tensorcomponent->storage_index,
                   discretefieldblockcomponent);
-  assert(discretefieldblockcomponent->invariant());
+  assert(discretefieldblockcomponent->checkInvariant());
   return discretefieldblockcomponent;
 }
+
+void DiscreteFieldBlock::releaseDiscreteFieldBlockComponent(
+    const string &name) {
+  // Only components that have been written can be released
+  assert(discretefield.lock()->field.lock()->project.lock()->streaming());
+  const auto &discretefieldblockcomponent =
+      discretefieldblockcomponents.at(name);
+  auto nerased = storage_indices.erase(
+      discretefieldblockcomponent->tensorcomponent->storage_index);
+  assert(nerased == 1);
+  discretefield.lock()->field.lock()->project.lock()->erasePath(
+      discretefieldblockcomponent->getPath());
+  discretefieldblockcomponents.erase(name);
+}
 }
@@ -32,6 +32,10 @@ struct DiscreteFieldBlock : Common,
       discretefieldblockcomponents; // children
   map<int, shared_ptr<DiscreteFieldBlockComponent>> storage_indices;
 
+  virtual shared_ptr<const Common> getParent() const {
+    return discretefield.lock();
+  }
+
   virtual bool invariant() const {
     bool inv =
         Common::invariant() && bool(discretefield.lock()) &&
@@ -73,6 +77,9 @@ private:
   }
   void read(const H5::CommonFG &loc, const string &entry,
             const shared_ptr<DiscreteField> &discretefield);
+  // Write a newly created discrete field block if the project is streaming
+  friend struct DiscreteFieldBlockComponent;
+  void stream() const;
 
 public:
   virtual ~DiscreteFieldBlock() {}
@@ -84,11 +91,16 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<DiscreteFieldBlockComponent> createDiscreteFieldBlockComponent(
       const string &name, const shared_ptr<TensorComponent> &tensorcomponent);
   shared_ptr<DiscreteFieldBlockComponent>
   readDiscreteFieldBlockComponent(const H5::CommonFG &loc, const string &entry);
+  // Remove a component that has been written while streaming from memory
+  void releaseDiscreteFieldBlockComponent(const string &name);
 };
 }
 
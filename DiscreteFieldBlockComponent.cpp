@@ -3,12 +3,9 @@
 #include "H5Helpers.hpp"
 
 #include <algorithm>
-#include <sstream>
 
 namespace SimulationIO {
 
-using std::ostringstream;
-
 void DiscreteFieldBlockComponent::read(
     const H5::CommonFG &loc, const string &entry,
     const shared_ptr<DiscreteFieldBlock> &discretefieldblock) {
@@ -20,8 +17,12 @@ void DiscreteFieldBlockComponent::read(
                                 ->project.lock()
                                 ->enumtype) == "DiscreteFieldBlockComponent");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "discretefieldblock", "name") ==
-         discretefieldblock->name);
+  assert(discretefieldblock->discretefield.lock()
+                 ->field.lock()
+                 ->project.lock()
+                 ->layout == Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "discretefieldblock", "name") ==
+             discretefieldblock->name);
   // TODO: Read and interpret objects (shallowly) instead of naively only
   // looking at their names
   tensorcomponent =
@@ -51,6 +52,18 @@ void DiscreteFieldBlockComponent::read(
                            data_extlink_objname);
       if (have_extlink) {
         data_type = type_extlink;
+        if (H5Iis_valid(discretefieldblock->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock()
+                            ->read_location.getId()) <= 0)
+          data_extlink_location = group;
+      } else if (H5Iis_valid(discretefieldblock->discretefield.lock()
+                                 ->field.lock()
+                                 ->project.lock()
+                                 ->read_location.getId()) > 0) {
+        // Reading metadata only: "data" is a hard link, and thus a dataset.
+        // Its object header is not accessed until the dataset is used.
+        data_type = type_dataset;
       } else {
         herr_t herr;
         H5O_info_t info;
@@ -71,14 +84,19 @@ void DiscreteFieldBlockComponent::read(
 }
 
 void DiscreteFieldBlockComponent::setData() {
+  releaseDataSet();
   data_type = type_empty;
   data_dataspace = H5::DataSpace();
   data_datatype = H5::DataType();
   data_dataset = H5::DataSet();
   data_extlink_filename.clear();
   data_extlink_objname.clear();
+  data_extlink_location = H5::Group();
   data_copy_loc = H5::hid();
   data_copy_name.clear();
+  data_dirty = true;
+  markDirty();
+  streamData();
 }
 
 void DiscreteFieldBlockComponent::setData(const H5::DataType &datatype,
@@ -88,6 +106,9 @@ void DiscreteFieldBlockComponent::setData(const H5::DataType &datatype,
   data_type = type_dataset;
   data_datatype = datatype;
   data_dataspace = dataspace;
+  data_dirty = true;
+  markDirty();
+  streamData();
 }
 
 void DiscreteFieldBlockComponent::setData(const string &filename,
@@ -97,6 +118,9 @@ void DiscreteFieldBlockComponent::setData(const string &filename,
   data_type = type_extlink;
   data_extlink_filename = filename;
   data_extlink_objname = objname;
+  data_dirty = true;
+  markDirty();
+  streamData();
 }
 
 void DiscreteFieldBlockComponent::setData(const H5::H5Location &loc,
@@ -106,6 +130,9 @@ void DiscreteFieldBlockComponent::setData(const H5::H5Location &loc,
   data_type = type_copy;
   data_copy_loc = loc.getId();
   data_copy_name = name;
+  data_dirty = true;
+  markDirty();
+  streamData();
 }
 
 void DiscreteFieldBlockComponent::setData(const vector<range> &range_) {
@@ -113,6 +140,83 @@ void DiscreteFieldBlockComponent::setData(const vector<range> &range_) {
     setData();
   data_type = type_range;
   data_range = range_;
+  data_dirty = true;
+  markDirty();
+  streamData();
+}
+
+void DiscreteFieldBlockComponent::openDataSet() const {
+  assert(data_type == type_dataset || data_type == type_extlink);
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  if (data_dataset_pooled) {
+    // Mark as most recently used
+    project->open_datasets.splice(project->open_datasets.end(),
+                                  project->open_datasets, data_dataset_pos);
+    return;
+  }
+  if (H5Iis_valid(data_dataset.getId()) > 0)
+    return;
+  // The dataset has been read metadata only, or is reached through an
+  // external link that was read. HDF5 follows external links when opening.
+  if (H5Iis_valid(project->read_location.getId()) > 0) {
+    data_dataset = project->read_location.openDataSet(getPath() + "/data");
+  } else {
+    // External links set via setData cannot be resolved
+    assert(H5Iis_valid(data_extlink_location.getId()) > 0);
+    data_dataset = data_extlink_location.openDataSet("data");
+  }
+  if (H5Iis_valid(data_datatype.getId()) <= 0) {
+    data_datatype = H5::DataType(H5Dget_type(data_dataset.getId()));
+    data_dataspace = data_dataset.getSpace();
+  }
+  data_dataset_pooled = true;
+  data_dataset_pos = project->open_datasets.insert(project->open_datasets.end(),
+                                                   shared_from_this());
+  // Close the least recently used datasets. Entries of components that have
+  // been destroyed, e.g. by releasing their blocks, are dropped first, so
+  // that they do not count towards the limit.
+  assert(project->max_open_datasets >= 1);
+  if (int(project->open_datasets.size()) > project->max_open_datasets)
+    project->open_datasets.remove_if(
+        [](const weak_ptr<const DiscreteFieldBlockComponent> &dfbc) {
+          return dfbc.expired();
+        });
+  while (int(project->open_datasets.size()) > project->max_open_datasets)
+    project->open_datasets.front().lock()->releaseDataSet();
+}
+
+void DiscreteFieldBlockComponent::releaseDataSet() const {
+  if (!data_dataset_pooled)
+    return;
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  project->open_datasets.erase(data_dataset_pos);
+  data_dataset_pooled = false;
+  data_dataset = H5::DataSet();
+}
+
+// The datatype and dataspace are set together, either by setData or when the
+// dataset is first opened
+H5::DataSpace DiscreteFieldBlockComponent::getDataSpace() const {
+  if (H5Iis_valid(data_datatype.getId()) <= 0)
+    openDataSet();
+  return data_dataspace;
+}
+
+H5::DataType DiscreteFieldBlockComponent::getDataType() const {
+  if (H5Iis_valid(data_datatype.getId()) <= 0)
+    openDataSet();
+  return data_datatype;
+}
+
+H5::DataSet DiscreteFieldBlockComponent::getDataSet() const {
+  openDataSet();
+  return data_dataset;
 }
 
 ostream &DiscreteFieldBlockComponent::output(ostream &os, int level) const {
@@ -125,13 +229,20 @@ ostream &DiscreteFieldBlockComponent::output(ostream &os, int level) const {
     os << "empty\n";
     break;
   case type_dataset: {
-    auto cls = data_datatype.getClass();
+    // Do not open datasets that were only read as metadata
+    if (H5Iis_valid(data_datatype.getId()) <= 0) {
+      os << "dataset (not opened)\n";
+      break;
+    }
+    auto datatype = data_datatype;
+    auto dataspace = data_dataspace;
+    auto cls = datatype.getClass();
     auto clsname = H5::className(cls);
-    auto typesize = data_datatype.getSize();
-    assert(data_dataspace.isSimple());
-    const int dim = data_dataspace.getSimpleExtentNdims();
+    auto typesize = datatype.getSize();
+    assert(dataspace.isSimple());
+    const int dim = dataspace.getSimpleExtentNdims();
     vector<hsize_t> size(dim);
-    data_dataspace.getSimpleExtentDims(size.data());
+    dataspace.getSimpleExtentDims(size.data());
     std::reverse(size.begin(), size.end());
     os << "dataset type=" << clsname << "(" << (8 * typesize)
        << " bit) shape=" << size << "\n";
@@ -164,7 +275,7 @@ ostream &DiscreteFieldBlockComponent::output(ostream &os, int level) const {
 
 void DiscreteFieldBlockComponent::write(const H5::CommonFG &loc,
                                         const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", discretefieldblock.lock()
                                          ->discretefield.lock()
@@ -173,21 +284,45 @@ void DiscreteFieldBlockComponent::write(const H5::CommonFG &loc,
                                          ->enumtype,
                       "DiscreteFieldBlockComponent");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "discretefieldblock", parent, ".");
-  H5::createHardLink(
-      group, "tensorcomponent", parent,
-      string("discretefield/field/tensortype/tensorcomponents/") +
-          tensorcomponent->name);
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  if (project->layout == Project::layout_lean) {
+    H5::createHardLink(group, "tensorcomponent", project->location,
+                       string("tensortypes/") +
+                           tensorcomponent->tensortype.lock()->name +
+                           "/tensorcomponents/" + tensorcomponent->name);
+  } else {
+    H5::createHardLink(group, "discretefieldblock", parent, ".");
+    H5::createHardLink(
+        group, "tensorcomponent", parent,
+        string("discretefield/field/tensortype/tensorcomponents/") +
+            tensorcomponent->name);
+  }
+  writeDataObject(group);
+}
+
+void DiscreteFieldBlockComponent::writeDataObject(
+    const H5::Group &group) const {
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  data_dirty = false;
   switch (data_type) {
   case type_empty: // do nothing
     break;
   case type_dataset: {
+    auto datatype = getDataType();
+    auto dataspace = getDataSpace();
+    releaseDataSet();
     auto proplist = H5::DSetCreatPropList();
     proplist.setFletcher32();
-    assert(data_dataspace.isSimple());
-    const int dim = data_dataspace.getSimpleExtentNdims();
+    assert(dataspace.isSimple());
+    const int dim = dataspace.getSimpleExtentNdims();
     vector<hsize_t> size(dim);
-    data_dataspace.getSimpleExtentDims(size.data());
+    dataspace.getSimpleExtentDims(size.data());
     vector<hsize_t> chunksize(dim);
     const hsize_t linear_size = 16; // 16^3 * 8 B = 32 kB
     for (int d = 0; d < dim; ++d)
@@ -196,8 +331,15 @@ void DiscreteFieldBlockComponent::write(const H5::CommonFG &loc,
     proplist.setShuffle(); // Shuffling improves compression
     const int level = 1;   // Level 1 is fast, but still offers good compression
     proplist.setDeflate(level);
-    data_dataset =
-        group.createDataSet("data", data_datatype, data_dataspace, proplist);
+    if (project->split == Project::split_none) {
+      data_dataset =
+          group.createDataSet("data", datatype, dataspace, proplist);
+    } else {
+      auto datagroup = openDataFileGroup(
+          group, dataspace.getSimpleExtentNpoints() * datatype.getSize());
+      data_dataset =
+          datagroup.createDataSet(name, datatype, dataspace, proplist);
+    }
     break;
   }
   case type_extlink:
@@ -211,8 +353,18 @@ void DiscreteFieldBlockComponent::write(const H5::CommonFG &loc,
     assert(!herr);
     auto lcpl = H5::take_hid(H5Pcreate(H5P_LINK_CREATE));
     assert(lcpl.valid());
-    herr = H5Ocopy(data_copy_loc, data_copy_name.c_str(), group.getId(), "data",
-                   ocpypl, lcpl);
+    if (project->split == Project::split_none) {
+      herr = H5Ocopy(data_copy_loc, data_copy_name.c_str(), group.getId(),
+                     "data", ocpypl, lcpl);
+    } else {
+      auto dataset = H5::take_hid(
+          H5Dopen2(data_copy_loc, data_copy_name.c_str(), H5P_DEFAULT));
+      assert(dataset.valid());
+      auto datagroup =
+          openDataFileGroup(group, H5Dget_storage_size(dataset));
+      herr = H5Ocopy(data_copy_loc, data_copy_name.c_str(),
+                     datagroup.getId(), name.c_str(), ocpypl, lcpl);
+    }
     assert(!herr);
     break;
   }
@@ -231,27 +383,105 @@ void DiscreteFieldBlockComponent::write(const H5::CommonFG &loc,
   }
 }
 
+// When splitting output, the data of this component are placed into a data
+// file, mirroring the path of this component there. Link to them and return
+// the group in which they are to be placed.
+H5::Group
+DiscreteFieldBlockComponent::openDataFileGroup(const H5::Group &group,
+                                               hsize_t size) const {
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  string filename;
+  auto datafile = project->openDataFile(*this, group, size, filename);
+  auto datagroup =
+      H5::createGroups(datafile, discretefieldblock.lock()->getPath() +
+                                     "/discretefieldblockcomponents");
+  if (H5::pathExists(datagroup, name)) {
+    herr_t herr = H5Ldelete(datagroup.getId(), name.c_str(), H5P_DEFAULT);
+    assert(!herr);
+  }
+  H5::createExternalLink(group, "data", filename, getPath());
+  return datagroup;
+}
+
+void DiscreteFieldBlockComponent::stream() const {
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  if (!project->streaming())
+    return;
+  // Write the tensor component if it is new
+  project->streamTensorComponent(*tensorcomponent);
+  const auto &loc = project->stream_location;
+  const auto &parentpath = discretefieldblock.lock()->getPath();
+  if (!H5::pathExists(loc, parentpath)) {
+    // The block is written together with this component
+    discretefieldblock.lock()->stream();
+    return;
+  }
+  auto parent = loc.openGroup(parentpath);
+  write(parent.openGroup("discretefieldblockcomponents"), parent);
+  dirty = false;
+}
+
+void DiscreteFieldBlockComponent::streamData() const {
+  const auto &project = discretefieldblock.lock()
+                            ->discretefield.lock()
+                            ->field.lock()
+                            ->project.lock();
+  if (!project->streaming())
+    return;
+  const auto &loc = project->stream_location;
+  const auto path = getPath();
+  if (!H5::pathExists(loc, path)) {
+    // The component has not been written yet; write it with its data
+    stream();
+    return;
+  }
+  replaceDataObject(loc.openGroup(path));
+  dirty = false;
+}
+
+// Replace the data that have been written previously
+void DiscreteFieldBlockComponent::replaceDataObject(
+    const H5::Group &group) const {
+  if (H5::pathExists(group, "data")) {
+    herr_t herr = H5Ldelete(group.getId(), "data", H5P_DEFAULT);
+    assert(!herr);
+  }
+  if (group.attrExists("data"))
+    group.removeAttr("data");
+  writeDataObject(group);
+}
+
+void DiscreteFieldBlockComponent::append(const H5::CommonFG &loc,
+                                         const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  // Rewrite the data object only if it has been set since it was written,
+  // since replacing a dataset discards its data
+  if (data_dirty)
+    replaceDataObject(loc.openGroup(name));
+}
+
 string DiscreteFieldBlockComponent::getPath() const {
-  const auto &discretefield = discretefieldblock.lock()->discretefield;
-  const auto &field = discretefield.lock()->field;
-  ostringstream buf;
-  buf << "fields/" << field.lock()->name << "/discretefields/"
-      << discretefield.lock()->name << "/discretefieldblocks/"
-      << discretefieldblock.lock()->name << "/discretefieldblockcomponents/"
-      << name;
-  return buf.str();
+  return discretefieldblock.lock()->getPath() +
+         "/discretefieldblockcomponents/" + name;
 }
 string DiscreteFieldBlockComponent::getName() const { return "data"; }
 
 template <typename T>
 void DiscreteFieldBlockComponent::writeData(const vector<T> &data) const {
   assert(data_type == type_dataset);
-  auto size = data_dataspace.getSimpleExtentNpoints();
+  auto size = getDataSpace().getSimpleExtentNpoints();
   assert(ptrdiff_t(data.size()) == size);
-  data_dataset.write(data.data(), H5::getType(data[0]));
+  auto dataset = getDataSet();
+  dataset.write(data.data(), H5::getType(data[0]));
   auto minmaxit = std::minmax_element(data.begin(), data.end());
-  H5::createAttribute(data_dataset, "minimum", *minmaxit.first);
-  H5::createAttribute(data_dataset, "maximum", *minmaxit.second);
+  H5::createAttribute(dataset, "minimum", *minmaxit.first);
+  H5::createAttribute(dataset, "maximum", *minmaxit.second);
 }
 template void
 DiscreteFieldBlockComponent::writeData(const vector<int> &data) const;
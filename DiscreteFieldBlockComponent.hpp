@@ -14,6 +14,7 @@
 
 namespace SimulationIO {
 
+using std::list;
 using std::make_shared;
 using std::map;
 using std::ostream;
@@ -35,14 +36,20 @@ struct DiscreteFieldBlockComponent
     type_copy,
     type_range
   } data_type;
-  H5::DataSpace data_dataspace;
-  H5::DataType data_datatype;
+  // When reading metadata only, these are set on first use; use getDataSpace,
+  // getDataType, and getDataSet to access them
+  mutable H5::DataSpace data_dataspace;
+  mutable H5::DataType data_datatype;
   mutable H5::DataSet data_dataset;
   string data_extlink_filename, data_extlink_objname;
   H5::hid data_copy_loc;
   string data_copy_name;
   vector<range> data_range;
 
+  virtual shared_ptr<const Common> getParent() const {
+    return discretefieldblock.lock();
+  }
+
   virtual bool invariant() const {
     bool inv =
         Common::invariant() && bool(discretefieldblock.lock()) &&
@@ -56,12 +63,9 @@ struct DiscreteFieldBlockComponent
                 ->discretefield.lock()
                 ->field.lock()
                 ->tensortype.get() == tensorcomponent->tensortype.lock().get();
-    // Ensure all discrete field block data have different tensor components
-    for (const auto &dfbd :
-         discretefieldblock.lock()->discretefieldblockcomponents)
-      if (dfbd.second.get() != this)
-        inv &= dfbd.second->tensorcomponent.get() != tensorcomponent.get();
-    // Ensure mapping from storage_indices is correct
+    // Ensure mapping from storage_indices is correct. Since storage indices
+    // are unique, this also ensures that all discrete field block components
+    // have different tensor components.
     inv &= discretefieldblock.lock()
                    ->storage_indices.at(tensorcomponent->storage_index)
                    .get() == this &&
@@ -80,6 +84,15 @@ struct DiscreteFieldBlockComponent
                 ->dimension) == (data_type == type_range);
     return inv;
   }
+  virtual bool fullInvariant() const {
+    bool inv = invariant();
+    // Ensure all discrete field block data have different tensor components
+    for (const auto &dfbd :
+         discretefieldblock.lock()->discretefieldblockcomponents)
+      if (dfbd.second.get() != this)
+        inv &= dfbd.second->tensorcomponent.get() != tensorcomponent.get();
+    return inv;
+  }
 
   DiscreteFieldBlockComponent() = delete;
   DiscreteFieldBlockComponent(const DiscreteFieldBlockComponent &) = delete;
@@ -95,8 +108,10 @@ struct DiscreteFieldBlockComponent
       const shared_ptr<DiscreteFieldBlock> &discretefieldblock,
       const shared_ptr<TensorComponent> &tensorcomponent)
       : Common(name), discretefieldblock(discretefieldblock),
-        tensorcomponent(tensorcomponent), data_type(type_empty) {}
-  DiscreteFieldBlockComponent(hidden) : Common(hidden()) {}
+        tensorcomponent(tensorcomponent), data_type(type_empty),
+        data_dataset_pooled(false), data_dirty(false) {}
+  DiscreteFieldBlockComponent(hidden)
+      : Common(hidden()), data_dataset_pooled(false), data_dirty(false) {}
 
 private:
   static shared_ptr<DiscreteFieldBlockComponent>
@@ -119,6 +134,28 @@ private:
   void read(const H5::CommonFG &loc, const string &entry,
             const shared_ptr<DiscreteFieldBlock> &discretefieldblock);
 
+  // Group holding an external link that was read; the linked dataset is
+  // opened through it on demand
+  H5::Group data_extlink_location;
+  // Position in the project's pool of datasets opened on demand
+  mutable bool data_dataset_pooled;
+  mutable list<weak_ptr<const DiscreteFieldBlockComponent>>::iterator
+      data_dataset_pos;
+  void openDataSet() const;
+  void releaseDataSet() const;
+
+  // Whether the data object has been set since it was last written;
+  // unchanged data objects are not rewritten when appending
+  mutable bool data_dirty;
+
+  // Write a newly created component, or its new data, if the project is
+  // streaming
+  void stream() const;
+  void streamData() const;
+  void writeDataObject(const H5::Group &group) const;
+  void replaceDataObject(const H5::Group &group) const;
+  H5::Group openDataFileGroup(const H5::Group &group, hsize_t size) const;
+
 public:
   virtual ~DiscreteFieldBlockComponent() {}
 
@@ -128,6 +165,10 @@ public:
   void setData(const H5::H5Location &loc, const string &name);
   void setData(const vector<range> &range_);
 
+  H5::DataSpace getDataSpace() const;
+  H5::DataType getDataType() const;
+  H5::DataSet getDataSet() const;
+
   virtual ostream &output(ostream &os, int level = 0) const;
   friend ostream &
   operator<<(ostream &os,
@@ -136,6 +177,8 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
 
   string getPath() const;
   string getName() const;
@@ -4,8 +4,16 @@
 
 #include "H5Helpers.hpp"
 
+#include <algorithm>
+#include <utility>
+
 namespace SimulationIO {
 
+using std::make_pair;
+using std::max;
+using std::min;
+using std::pair;
+
 void Discretization::read(const H5::CommonFG &loc, const string &entry,
                           const shared_ptr<Manifold> &manifold) {
   this->manifold = manifold;
@@ -14,13 +22,14 @@ void Discretization::read(const H5::CommonFG &loc, const string &entry,
                                    manifold->project.lock()->enumtype) ==
          "Discretization");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "manifold", "name") ==
-         manifold->name);
+  const bool lean = manifold->project.lock()->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "manifold", "name") ==
+                     manifold->name);
   configuration = manifold->project.lock()->configurations.at(
       H5::readGroupAttribute<string>(group, "configuration", "name"));
-  assert(H5::readGroupAttribute<string>(
-             group, string("configuration/discretizations/") + name, "name") ==
-         name);
+  assert(lean || H5::readGroupAttribute<string>(
+                     group, string("configuration/discretizations/") + name,
+                     "name") == name);
   H5::readGroup(group, "discretizationblocks",
                 [&](const H5::Group &group, const string &name) {
                   readDiscretizationBlock(group, name);
@@ -39,11 +48,18 @@ ostream &Discretization::output(ostream &os, int level) const {
 
 void Discretization::write(const H5::CommonFG &loc,
                            const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", manifold.lock()->project.lock()->enumtype,
                       "Discretization");
   H5::createAttribute(group, "name", name);
+  const auto &project = manifold.lock()->project.lock();
+  if (project->layout == Project::layout_lean) {
+    H5::createHardLink(group, "configuration", project->location,
+                       string("configurations/") + configuration->name);
+    H5::createGroup(group, "discretizationblocks", discretizationblocks);
+    return;
+  }
   H5::createHardLink(group, "manifold", parent, ".");
   H5::createHardLink(group, "configuration", parent,
                      string("project/configurations/") + configuration->name);
@@ -55,13 +71,28 @@ void Discretization::write(const H5::CommonFG &loc,
   group.createGroup("parent_discretizations");
 }
 
+void Discretization::append(const H5::CommonFG &loc,
+                            const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "discretizationblocks", discretizationblocks);
+}
+
+string Discretization::getPath() const {
+  return manifold.lock()->getPath() + "/discretizations/" + name;
+}
+
 shared_ptr<DiscretizationBlock>
 Discretization::createDiscretizationBlock(const string &name) {
   auto discretizationblock =
       DiscretizationBlock::create(name, shared_from_this());
   checked_emplace(discretizationblocks, discretizationblock->name,
                   discretizationblock);
-  assert(discretizationblock->invariant());
+  manifold.lock()->project.lock()->insertPath(*this, "discretizationblocks",
+                                              discretizationblock);
+  invalidateBlockIndex();
+  discretizationblock->markDirty();
+  assert(discretizationblock->checkInvariant());
   return discretizationblock;
 }
 
@@ -72,7 +103,156 @@ Discretization::readDiscretizationBlock(const H5::CommonFG &loc,
       DiscretizationBlock::create(loc, entry, shared_from_this());
   checked_emplace(discretizationblocks, discretizationblock->name,
                   discretizationblock);
-  assert(discretizationblock->invariant());
+  manifold.lock()->project.lock()->insertPath(*this, "discretizationblocks",
+                                              discretizationblock);
+  invalidateBlockIndex();
+  assert(discretizationblock->checkInvariant());
   return discretizationblock;
 }
+
+namespace {
+// Maximum number of blocks in a leaf of the bounding volume hierarchy
+const int max_leaf_blocks = 4;
+
+// Build the subtree for the blocks in [begin, end), splitting at the median
+// block centre along the direction in which the centres are spread widest
+int buildBlockIndex(vector<int> &order, int begin, int end, int rank,
+                    const vector<hssize_t> &block_lower,
+                    const vector<hssize_t> &block_upper,
+                    vector<hssize_t> &lower, vector<hssize_t> &upper,
+                    vector<pair<int, int>> &children,
+                    vector<pair<int, int>> &ranges) {
+  const int node = children.size();
+  children.emplace_back(-1, -1);
+  ranges.emplace_back(begin, end);
+  lower.insert(lower.end(), block_lower.begin() + order[begin] * rank,
+               block_lower.begin() + (order[begin] + 1) * rank);
+  upper.insert(upper.end(), block_upper.begin() + order[begin] * rank,
+               block_upper.begin() + (order[begin] + 1) * rank);
+  int split_dir = -1;
+  hssize_t split_extent = 0;
+  for (int d = 0; d < rank; ++d) {
+    hssize_t cmin = block_lower[order[begin] * rank + d] +
+                    block_upper[order[begin] * rank + d];
+    hssize_t cmax = cmin;
+    for (int i = begin; i < end; ++i) {
+      const int b = order[i];
+      lower[node * rank + d] =
+          min(lower[node * rank + d], block_lower[b * rank + d]);
+      upper[node * rank + d] =
+          max(upper[node * rank + d], block_upper[b * rank + d]);
+      const hssize_t c = block_lower[b * rank + d] + block_upper[b * rank + d];
+      cmin = min(cmin, c);
+      cmax = max(cmax, c);
+    }
+    if (cmax - cmin > split_extent) {
+      split_dir = d;
+      split_extent = cmax - cmin;
+    }
+  }
+  if (end - begin <= max_leaf_blocks || split_dir < 0)
+    return node;
+  const int mid = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + mid,
+                   order.begin() + end, [&](int a, int b) {
+                     return block_lower[a * rank + split_dir] +
+                                block_upper[a * rank + split_dir] <
+                            block_lower[b * rank + split_dir] +
+                                block_upper[b * rank + split_dir];
+                   });
+  const int left = buildBlockIndex(order, begin, mid, rank, block_lower,
+                                   block_upper, lower, upper, children, ranges);
+  const int right = buildBlockIndex(order, mid, end, rank, block_lower,
+                                    block_upper, lower, upper, children,
+                                    ranges);
+  children[node] = make_pair(left, right);
+  return node;
+}
+
+vector<shared_ptr<DiscretizationBlock>>
+sortByName(vector<shared_ptr<DiscretizationBlock>> blocks) {
+  std::sort(blocks.begin(), blocks.end(),
+            [](const shared_ptr<DiscretizationBlock> &a,
+               const shared_ptr<DiscretizationBlock> &b) {
+              return a->name < b->name;
+            });
+  return blocks;
+}
+}
+
+const Discretization::block_index_t &Discretization::getBlockIndex() const {
+  if (block_index)
+    return *block_index;
+  auto index = make_shared<block_index_t>();
+  const int rank = index->rank = manifold.lock()->dimension;
+  vector<hssize_t> block_lower, block_upper;
+  vector<shared_ptr<DiscretizationBlock>> blocks;
+  for (const auto &db : discretizationblocks) {
+    const auto &region = db.second->region;
+    if (!region.valid())
+      continue;
+    const vector<hssize_t> lo(region.lower()), hi(region.upper());
+    block_lower.insert(block_lower.end(), lo.begin(), lo.end());
+    block_upper.insert(block_upper.end(), hi.begin(), hi.end());
+    blocks.push_back(db.second);
+  }
+  const int nblocks = blocks.size();
+  if (nblocks > 0) {
+    vector<int> order(nblocks);
+    for (int i = 0; i < nblocks; ++i)
+      order[i] = i;
+    vector<pair<int, int>> children, ranges;
+    buildBlockIndex(order, 0, nblocks, rank, block_lower, block_upper,
+                    index->lower, index->upper, children, ranges);
+    for (size_t n = 0; n < children.size(); ++n)
+      index->nodes.push_back({ranges[n].first, ranges[n].second,
+                              children[n].first, children[n].second});
+    for (int i = 0; i < nblocks; ++i)
+      index->blocks.push_back(blocks[order[i]]);
+  }
+  block_index = index;
+  return *block_index;
+}
+
+vector<shared_ptr<DiscretizationBlock>>
+Discretization::findDiscretizationBlocksContaining(
+    const point_t &point) const {
+  assert(point.valid() && point.rank() == manifold.lock()->dimension);
+  return findDiscretizationBlocksIntersecting(
+      box_t(point, point + point_t(vector<hssize_t>(point.rank(), 1))));
+}
+
+vector<shared_ptr<DiscretizationBlock>>
+Discretization::findDiscretizationBlocksIntersecting(const box_t &box) const {
+  assert(box.valid() && box.rank() == manifold.lock()->dimension);
+  const auto &index = getBlockIndex();
+  vector<shared_ptr<DiscretizationBlock>> result;
+  if (index.nodes.empty() || box.empty())
+    return result;
+  const int rank = index.rank;
+  const vector<hssize_t> lo(box.lower()), hi(box.upper());
+  auto overlaps = [&](const hssize_t *lower, const hssize_t *upper) {
+    for (int d = 0; d < rank; ++d)
+      if (upper[d] <= lo[d] || hi[d] <= lower[d])
+        return false;
+    return true;
+  };
+  vector<int> stack{0};
+  while (!stack.empty()) {
+    const int n = stack.back();
+    stack.pop_back();
+    if (!overlaps(&index.lower[n * rank], &index.upper[n * rank]))
+      continue;
+    const auto &node = index.nodes[n];
+    if (node.left >= 0) {
+      stack.push_back(node.right);
+      stack.push_back(node.left);
+      continue;
+    }
+    for (int i = node.begin; i < node.end; ++i)
+      if (!index.blocks[i]->region.isdisjoint(box))
+        result.push_back(index.blocks[i]);
+  }
+  return sortByName(std::move(result));
+}
 }
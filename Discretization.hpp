@@ -4,6 +4,7 @@
 #include "Common.hpp"
 #include "Configuration.hpp"
 #include "Manifold.hpp"
+#include "RegionCalculus.hpp"
 
 #include <H5Cpp.h>
 
@@ -11,6 +12,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace SimulationIO {
 
@@ -19,8 +21,13 @@ using std::map;
 using std::ostream;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 
+typedef RegionCalculus::dpoint<hssize_t> point_t;
+typedef RegionCalculus::dbox<hssize_t> box_t;
+typedef RegionCalculus::dregion<hssize_t> region_t;
+
 struct DiscreteField;
 struct DiscretizationBlock;
 struct SubDiscretization;
@@ -33,6 +40,8 @@ struct Discretization : Common, std::enable_shared_from_this<Discretization> {
   map<string, weak_ptr<SubDiscretization>> parent_discretizations; // backlinks
   NoBackLink<weak_ptr<DiscreteField>> discretefields;
 
+  virtual shared_ptr<const Common> getParent() const { return manifold.lock(); }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(manifold.lock()) &&
            manifold.lock()->discretizations.count(name) &&
@@ -83,12 +92,41 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<DiscretizationBlock> createDiscretizationBlock(const string &name);
   shared_ptr<DiscretizationBlock>
   readDiscretizationBlock(const H5::CommonFG &loc, const string &entry);
 
+  // Find the discretization blocks whose regions contain a point or
+  // intersect a box, ordered by name. Blocks without a region are never
+  // found. These queries use a bounding volume hierarchy over the block
+  // regions that is built on first use, and is discarded when blocks are
+  // added or their regions change.
+  vector<shared_ptr<DiscretizationBlock>>
+  findDiscretizationBlocksContaining(const point_t &point) const;
+  vector<shared_ptr<DiscretizationBlock>>
+  findDiscretizationBlocksIntersecting(const box_t &box) const;
+
 private:
+  struct block_index_t {
+    struct node_t {
+      int begin, end;  // range of blocks
+      int left, right; // children, or -1 for leaves
+    };
+    int rank;
+    vector<node_t> nodes;   // the root is node 0
+    vector<hssize_t> lower; // bounding box of each node, rank elements each
+    vector<hssize_t> upper;
+    vector<shared_ptr<DiscretizationBlock>> blocks;
+  };
+  mutable shared_ptr<block_index_t> block_index;
+  const block_index_t &getBlockIndex() const;
+  friend struct DiscretizationBlock;
+  void invalidateBlockIndex() const { block_index.reset(); }
+
   friend struct SubDiscretization;
   void insertChild(const string &name,
                    const shared_ptr<SubDiscretization> &subdiscretization) {
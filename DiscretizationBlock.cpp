@@ -15,13 +15,13 @@ void read_active(const H5::H5Location &group,
   // - C++ pads empty struct
   // - HDF5 cannot handle empty arrays
   static_assert(D > 0, "");
-  if (active.valid())
+  // Only the rank of the manifold can be read
+  const auto manifold =
+      discretizationblock.discretization.lock()->manifold.lock();
+  if (active.valid() || manifold->dimension != D)
     return;
   vector<RegionCalculus::box<hssize_t, D>> boxes;
-  const auto &boxtype = discretizationblock.discretization.lock()
-                            ->manifold.lock()
-                            ->project.lock()
-                            ->boxtypes.at(D);
+  const auto &boxtype = manifold->project.lock()->boxtypes.at(D);
   assert(sizeof(boxes[0]) == boxtype.getSize());
 #if 0
   H5E_auto2_t func;
@@ -57,8 +57,10 @@ void DiscretizationBlock::read(
              discretization->manifold.lock()->project.lock()->enumtype) ==
          "DiscretizationBlock");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "discretization", "name") ==
-         discretization->name);
+  assert(discretization->manifold.lock()->project.lock()->layout ==
+             Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "discretization", "name") ==
+             discretization->name);
   if (group.attrExists("offset")) {
     vector<hssize_t> offset, shape;
     H5::readAttribute(group, "offset", offset);
@@ -113,14 +115,20 @@ void write_active(const H5::H5Location &group,
 
 void DiscretizationBlock::write(const H5::CommonFG &loc,
                                 const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(
       group, "type",
       discretization.lock()->manifold.lock()->project.lock()->enumtype,
       "DiscretizationBlock");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "discretization", parent, ".");
+  if (discretization.lock()->manifold.lock()->project.lock()->layout ==
+      Project::layout_full)
+    H5::createHardLink(group, "discretization", parent, ".");
+  writeRegion(group);
+}
+
+void DiscretizationBlock::writeRegion(const H5::Group &group) const {
   if (region.valid()) {
 #warning "TODO: write using boxtype HDF5 type"
     vector<hssize_t> offset = region.lower(), shape = region.shape();
@@ -137,4 +145,15 @@ void DiscretizationBlock::write(const H5::CommonFG &loc,
     write_active<4>(group, *this, active);
   }
 }
+
+void DiscretizationBlock::append(const H5::CommonFG &loc,
+                                 const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  // The region and active region may have been modified
+  for (const auto &attr : {"offset", "shape", "active"})
+    if (group.attrExists(attr))
+      group.removeAttr(attr);
+  writeRegion(group);
+}
 }
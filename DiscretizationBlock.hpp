@@ -22,10 +22,6 @@ using std::string;
 using std::vector;
 using std::weak_ptr;
 
-typedef RegionCalculus::dpoint<hssize_t> point_t;
-typedef RegionCalculus::dbox<hssize_t> box_t;
-typedef RegionCalculus::dregion<hssize_t> region_t;
-
 struct DiscreteFieldBlock;
 
 struct DiscretizationBlock : Common,
@@ -40,6 +36,10 @@ struct DiscretizationBlock : Common,
   // connectivity? neighbouring blocks?
   // overlaps?
 
+  virtual shared_ptr<const Common> getParent() const {
+    return discretization.lock();
+  }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(discretization.lock()) &&
            discretization.lock()->discretizationblocks.count(name) &&
@@ -82,21 +82,31 @@ private:
 public:
   virtual ~DiscretizationBlock() {}
 
-  void setRegion() { region.reset(); }
+  void setRegion() {
+    region.reset();
+    discretization.lock()->invalidateBlockIndex();
+    markDirty();
+  }
   void setRegion(const box_t &region_) {
     assert(region_.valid() &&
            region_.rank() ==
                discretization.lock()->manifold.lock()->dimension &&
            !region_.empty());
     region = region_;
+    discretization.lock()->invalidateBlockIndex();
+    markDirty();
   }
   box_t getRegion() const { return region; }
 
-  void setActive() { active.reset(); }
+  void setActive() {
+    active.reset();
+    markDirty();
+  }
   void setActive(const region_t &active_) {
     assert(active_.valid() &&
            active_.rank() == discretization.lock()->manifold.lock()->dimension);
     active = active_;
+    markDirty();
   }
   region_t getActive() const { return active; }
 
@@ -107,8 +117,12 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
 
 private:
+  void writeRegion(const H5::Group &group) const;
+
   friend struct DiscreteFieldBlock;
   void noinsert(const shared_ptr<DiscreteFieldBlock> &discretefieldblock) {}
 };
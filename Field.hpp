@@ -39,6 +39,8 @@ struct Field : Common, std::enable_shared_from_this<Field> {
   map<string, shared_ptr<DiscreteField>> discretefields; // children
   NoBackLink<CoordinateField> coordinatefields;
 
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     bool inv = Common::invariant() && bool(project.lock()) &&
                project.lock()->fields.count(name) &&
@@ -52,6 +54,10 @@ struct Field : Common, std::enable_shared_from_this<Field> {
                bool(tensortype) &&
                tangentspace->dimension == tensortype->dimension &&
                tensortype->fields.nobacklink();
+    return inv;
+  }
+  virtual bool fullInvariant() const {
+    bool inv = invariant();
     for (const auto &df : discretefields)
       inv &= !df.first.empty() && bool(df.second);
     return inv;
@@ -107,6 +113,9 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<DiscreteField>
   createDiscreteField(const string &name,
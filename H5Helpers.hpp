@@ -503,16 +503,112 @@ inline void readExternalLink(const CommonFG &link_loc,
   }
 }
 
-// Write a map (ignoring the keys)
+// Check whether a path exists, checking each link on the path in turn
+inline bool pathExists(const CommonFG &loc, const std::string &path) {
+  auto lapl = take_hid(H5Pcreate(H5P_LINK_ACCESS));
+  assert(lapl.valid());
+  std::string::size_type pos = 0;
+  for (;;) {
+    auto end = path.find('/', pos);
+    auto exists = H5Lexists(loc.getLocId(), path.substr(0, end).c_str(), lapl);
+    assert(exists >= 0);
+    if (!exists)
+      return false;
+    if (end == std::string::npos)
+      return true;
+    pos = end + 1;
+  }
+}
+
+// Open a group, creating it and all intermediate groups if necessary
+inline Group createGroups(const CommonFG &loc, const std::string &path) {
+  auto group = loc.openGroup(".");
+  std::string::size_type pos = 0;
+  while (pos < path.size()) {
+    auto end = std::min(path.find('/', pos), path.size());
+    auto name = path.substr(pos, end - pos);
+    if (pathExists(group, name))
+      group = group.openGroup(name);
+    else
+      group = group.createGroup(name);
+    pos = end + 1;
+  }
+  return group;
+}
+
+// Write and append groups whose entries are shared pointers to subtypes of
+// Common, held either in a map (ignoring the keys) or in a vector
+namespace detail {
 template <typename K, typename T>
+const T &groupEntry(const std::pair<const K, T> &p) {
+  return p.second;
+}
+template <typename T> const T &groupEntry(const T &entry) { return entry; }
+
+template <typename C>
 Group createGroup(const CommonFG &loc, const std::string &name,
-                  const std::map<K, T> &m) {
-  // We assume that T is a subtype of Common
+                  const C &entries) {
   auto group = loc.createGroup(name);
-  for (const auto &p : m)
-    p.second->write(group, *getLocation(loc));
+  for (const auto &e : entries) {
+    const auto &entry = groupEntry(e);
+    entry->write(group, *getLocation(loc));
+    entry->dirty = false;
+  }
+  return group;
+}
+
+template <typename C>
+Group appendGroup(const CommonFG &loc, const std::string &name,
+                  const C &entries) {
+  auto group = loc.openGroup(name);
+  auto lapl = take_hid(H5Pcreate(H5P_LINK_ACCESS));
+  assert(lapl.valid());
+  for (const auto &e : entries) {
+    const auto &entry = groupEntry(e);
+    if (!entry->dirty)
+      continue;
+    auto exists = H5Lexists(group.getLocId(), entry->name.c_str(), lapl);
+    assert(exists >= 0);
+    if (exists)
+      entry->append(group, *getLocation(loc));
+    else
+      entry->write(group, *getLocation(loc));
+    entry->dirty = false;
+  }
   return group;
 }
+}
+
+// Write a map (ignoring the keys)
+template <typename K, typename T>
+Group createGroup(const CommonFG &loc, const std::string &name,
+                  const std::map<K, T> &m) {
+  return detail::createGroup(loc, name, m);
+}
+
+// Write a vector, in the order of its entries
+template <typename T>
+Group createGroup(const CommonFG &loc, const std::string &name,
+                  const std::vector<T> &entries) {
+  return detail::createGroup(loc, name, entries);
+}
+
+// Append to a map that has already been written (ignoring the keys): write
+// new entries, and append to existing ones. Entries that are not dirty are
+// skipped.
+template <typename K, typename T>
+Group appendGroup(const CommonFG &loc, const std::string &name,
+                  const std::map<K, T> &m) {
+  return detail::appendGroup(loc, name, m);
+}
+
+// Append to a vector that has already been written, in the order of its
+// entries
+template <typename T>
+Group appendGroup(const CommonFG &loc, const std::string &name,
+                  const std::vector<T> &entries) {
+  return detail::appendGroup(loc, name, entries);
+}
 
 // This is probably never correct; instead, the group's entries should insert
 // themselves into the group
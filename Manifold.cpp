@@ -22,12 +22,14 @@ void Manifold::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(group, "type", project->enumtype) ==
          "Manifold");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "project", "name") ==
-         project->name);
+  const bool lean = project->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "project", "name") ==
+                     project->name);
   configuration = project->configurations.at(
       H5::readGroupAttribute<string>(group, "configuration", "name"));
-  assert(H5::readGroupAttribute<string>(
-             group, string("configuration/manifolds/") + name, "name") == name);
+  assert(lean || H5::readGroupAttribute<string>(
+                     group, string("configuration/manifolds/") + name,
+                     "name") == name);
   H5::readAttribute(group, "dimension", dimension);
   H5::readGroup(group, "discretizations",
                 [&](const H5::Group &group, const string &name) {
@@ -61,30 +63,47 @@ ostream &Manifold::output(ostream &os, int level) const {
 
 void Manifold::write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", project.lock()->enumtype, "Manifold");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "project", parent, ".");
+  const bool lean = project.lock()->layout == Project::layout_lean;
+  if (!lean)
+    H5::createHardLink(group, "project", parent, ".");
   H5::createHardLink(group, "configuration", parent,
                      string("configurations/") + configuration->name);
-  H5::createHardLink(group, string("project/configurations/") +
-                                configuration->name + "/manifolds",
-                     name, group, ".");
+  if (!lean)
+    H5::createHardLink(group, string("project/configurations/") +
+                                  configuration->name + "/manifolds",
+                       name, group, ".");
   H5::createAttribute(group, "dimension", dimension);
   H5::createGroup(group, "discretizations", discretizations);
   H5::createGroup(group, "subdiscretizations", subdiscretizations);
-  group.createGroup("fields");
-  group.createGroup("coordinatesystems");
+  if (!lean) {
+    group.createGroup("fields");
+    group.createGroup("coordinatesystems");
+  }
 }
 
+void Manifold::append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "discretizations", discretizations);
+  H5::appendGroup(group, "subdiscretizations", subdiscretizations);
+}
+
+string Manifold::getPath() const { return string("manifolds/") + name; }
+
 shared_ptr<Discretization>
 Manifold::createDiscretization(const string &name,
                                const shared_ptr<Configuration> &configuration) {
   auto discretization =
       Discretization::create(name, shared_from_this(), configuration);
   checked_emplace(discretizations, discretization->name, discretization);
-  assert(discretization->invariant());
+  project.lock()->insertPath(*this, "discretizations", discretization);
+  discretization->markDirty();
+  assert(discretization->checkInvariant());
   return discretization;
 }
 
@@ -92,7 +111,8 @@ shared_ptr<Discretization> Manifold::readDiscretization(const H5::CommonFG &loc,
                                                         const string &entry) {
   auto discretization = Discretization::create(loc, entry, shared_from_this());
   checked_emplace(discretizations, discretization->name, discretization);
-  assert(discretization->invariant());
+  project.lock()->insertPath(*this, "discretizations", discretization);
+  assert(discretization->checkInvariant());
   return discretization;
 }
 
@@ -105,7 +125,9 @@ shared_ptr<SubDiscretization> Manifold::createSubDiscretization(
                                 child_discretization, factor, offset);
   checked_emplace(subdiscretizations, subdiscretization->name,
                   subdiscretization);
-  assert(subdiscretization->invariant());
+  project.lock()->insertPath(*this, "subdiscretizations", subdiscretization);
+  subdiscretization->markDirty();
+  assert(subdiscretization->checkInvariant());
   return subdiscretization;
 }
 
@@ -115,7 +137,8 @@ Manifold::readSubDiscretization(const H5::CommonFG &loc, const string &entry) {
       SubDiscretization::create(loc, entry, shared_from_this());
   checked_emplace(subdiscretizations, subdiscretization->name,
                   subdiscretization);
-  assert(subdiscretization->invariant());
+  project.lock()->insertPath(*this, "subdiscretizations", subdiscretization);
+  assert(subdiscretization->checkInvariant());
   return subdiscretization;
 }
 }
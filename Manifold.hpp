@@ -39,6 +39,8 @@ struct Manifold : Common, std::enable_shared_from_this<Manifold> {
   map<string, weak_ptr<Field>> fields;                           // backlinks
   map<string, weak_ptr<CoordinateSystem>> coordinatesystems;     // backlinks
 
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     bool inv = Common::invariant() && bool(project.lock()) &&
                project.lock()->manifolds.count(name) &&
@@ -46,6 +48,10 @@ struct Manifold : Common, std::enable_shared_from_this<Manifold> {
                bool(configuration) && configuration->manifolds.count(name) &&
                configuration->manifolds.at(name).lock().get() == this &&
                dimension >= 0;
+    return inv;
+  }
+  virtual bool fullInvariant() const {
+    bool inv = invariant();
     for (const auto &d : discretizations)
       inv &= !d.first.empty() && bool(d.second);
     return inv;
@@ -92,6 +98,9 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<Discretization>
   createDiscretization(const string &name,
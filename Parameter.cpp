@@ -1,9 +1,13 @@
 #include "Parameter.hpp"
 
+#include "Configuration.hpp"
 #include "ParameterValue.hpp"
 
 #include "H5Helpers.hpp"
 
+#include <cmath>
+#include <iterator>
+
 namespace SimulationIO {
 
 void Parameter::read(const H5::CommonFG &loc, const string &entry,
@@ -13,8 +17,9 @@ void Parameter::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(group, "type", project->enumtype) ==
          "Parameter");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "project", "name") ==
-         project->name);
+  assert(project->layout == Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "project", "name") ==
+             project->name);
   H5::readGroup(group, "parametervalues",
                 [&](const H5::Group &group, const string &name) {
                   readParameterValue(group, name);
@@ -30,18 +35,30 @@ ostream &Parameter::output(ostream &os, int level) const {
 
 void Parameter::write(const H5::CommonFG &loc,
                       const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", project.lock()->enumtype, "Parameter");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "project", parent, ".");
+  if (project.lock()->layout == Project::layout_full)
+    H5::createHardLink(group, "project", parent, ".");
   H5::createGroup(group, "parametervalues", parametervalues);
 }
 
+void Parameter::append(const H5::CommonFG &loc,
+                       const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "parametervalues", parametervalues);
+}
+
+string Parameter::getPath() const { return string("parameters/") + name; }
+
 shared_ptr<ParameterValue> Parameter::createParameterValue(const string &name) {
   auto parametervalue = ParameterValue::create(name, shared_from_this());
   checked_emplace(parametervalues, parametervalue->name, parametervalue);
-  assert(parametervalue->invariant());
+  project.lock()->insertPath(*this, "parametervalues", parametervalue);
+  parametervalue->markDirty();
+  assert(parametervalue->checkInvariant());
   return parametervalue;
 }
 
@@ -49,7 +66,90 @@ shared_ptr<ParameterValue>
 Parameter::readParameterValue(const H5::CommonFG &loc, const string &entry) {
   auto parametervalue = ParameterValue::create(loc, entry, shared_from_this());
   checked_emplace(parametervalues, parametervalue->name, parametervalue);
-  assert(parametervalue->invariant());
+  project.lock()->insertPath(*this, "parametervalues", parametervalue);
+  insertValueIndex(parametervalue);
+  assert(parametervalue->checkInvariant());
   return parametervalue;
 }
+
+namespace {
+// The key of a parameter value in the value index; returns false if the
+// parameter value is not numeric
+bool valueIndexKey(const ParameterValue &parametervalue, double &key) {
+  switch (parametervalue.value_type) {
+  case ParameterValue::type_int:
+    key = double(parametervalue.value_int);
+    break;
+  case ParameterValue::type_double:
+    key = parametervalue.value_double;
+    break;
+  default:
+    // not numeric
+    return false;
+  }
+  // NaN cannot be ordered
+  return !std::isnan(key);
+}
+}
+
+void Parameter::insertValueIndex(
+    const shared_ptr<ParameterValue> &parametervalue) {
+  double key;
+  if (valueIndexKey(*parametervalue, key))
+    value_index.emplace(key, parametervalue);
+}
+
+void Parameter::eraseValueIndex(const ParameterValue &parametervalue) {
+  double key;
+  if (!valueIndexKey(parametervalue, key))
+    return;
+  auto range = value_index.equal_range(key);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if (iter->second.get() == &parametervalue) {
+      value_index.erase(iter);
+      return;
+    }
+  }
+  assert(0);
+}
+
+shared_ptr<ParameterValue> Parameter::findParameterValue(double value) const {
+  auto iter = value_index.find(value);
+  if (iter == value_index.end())
+    return nullptr;
+  return iter->second;
+}
+
+vector<shared_ptr<ParameterValue>>
+Parameter::findParameterValues(double minimum, double maximum) const {
+  vector<shared_ptr<ParameterValue>> vals;
+  for (auto iter = value_index.lower_bound(minimum),
+            end = value_index.upper_bound(maximum);
+       iter != end; ++iter)
+    vals.push_back(iter->second);
+  return vals;
+}
+
+shared_ptr<ParameterValue>
+Parameter::findNearestParameterValue(double value) const {
+  if (value_index.empty())
+    return nullptr;
+  auto iter = value_index.lower_bound(value);
+  if (iter == value_index.end())
+    return std::prev(iter)->second;
+  if (iter == value_index.begin())
+    return iter->second;
+  auto prev = std::prev(iter);
+  return value - prev->first <= iter->first - value ? prev->second
+                                                     : iter->second;
+}
+
+vector<shared_ptr<Configuration>>
+Parameter::findConfigurations(double minimum, double maximum) const {
+  vector<shared_ptr<Configuration>> confs;
+  for (const auto &val : findParameterValues(minimum, maximum))
+    for (const auto &conf : val->configurations)
+      confs.push_back(conf.second.lock());
+  return confs;
+}
 }
@@ -11,16 +11,20 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace SimulationIO {
 
 using std::make_shared;
 using std::map;
+using std::multimap;
 using std::ostream;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 
+struct Configuration;
 struct ParameterValue;
 
 struct Parameter : Common, std::enable_shared_from_this<Parameter> {
@@ -28,6 +32,18 @@ struct Parameter : Common, std::enable_shared_from_this<Parameter> {
   map<string, shared_ptr<ParameterValue>> parametervalues; // children
   // type, range?, description?
 
+private:
+  // Numeric (integer and floating point) parameter values, sorted by value.
+  // Parameter values are added to and removed from the index as their
+  // values change.
+  multimap<double, shared_ptr<ParameterValue>> value_index;
+  friend struct ParameterValue;
+  void insertValueIndex(const shared_ptr<ParameterValue> &parametervalue);
+  void eraseValueIndex(const ParameterValue &parametervalue);
+
+public:
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(project.lock()) &&
            project.lock()->parameters.count(name) &&
@@ -69,10 +85,29 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<ParameterValue> createParameterValue(const string &name);
   shared_ptr<ParameterValue> readParameterValue(const H5::CommonFG &loc,
                                                 const string &entry);
+
+  // Look up parameter values by their numeric value, in O(log n) time.
+  // Parameter values that are empty or strings are never found.
+  // Return the parameter value with the given value, or null if there is none
+  shared_ptr<ParameterValue> findParameterValue(double value) const;
+  // Return all parameter values in the closed interval [minimum, maximum],
+  // sorted by value
+  vector<shared_ptr<ParameterValue>> findParameterValues(double minimum,
+                                                         double maximum) const;
+  // Return the parameter value closest to the given value, or null if there
+  // are no numeric parameter values
+  shared_ptr<ParameterValue> findNearestParameterValue(double value) const;
+  // Return all configurations using a parameter value in the closed interval
+  // [minimum, maximum], sorted by value
+  vector<shared_ptr<Configuration>> findConfigurations(double minimum,
+                                                       double maximum) const;
 };
 }
 
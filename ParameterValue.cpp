@@ -45,18 +45,36 @@ void ParameterValue::read(const H5::CommonFG &loc, const string &entry,
   // assert(H5::checkGroupNames(group, "configurations", configurations));
 }
 
-void ParameterValue::setValue() { value_type = type_empty; }
+void ParameterValue::setValue() {
+  auto parameter = this->parameter.lock();
+  parameter->eraseValueIndex(*this);
+  value_type = type_empty;
+  parameter->insertValueIndex(shared_from_this());
+  markDirty();
+}
 void ParameterValue::setValue(long long i) {
+  auto parameter = this->parameter.lock();
+  parameter->eraseValueIndex(*this);
   value_int = i;
   value_type = type_int;
+  parameter->insertValueIndex(shared_from_this());
+  markDirty();
 }
 void ParameterValue::setValue(double d) {
+  auto parameter = this->parameter.lock();
+  parameter->eraseValueIndex(*this);
   value_double = d;
   value_type = type_double;
+  parameter->insertValueIndex(shared_from_this());
+  markDirty();
 }
 void ParameterValue::setValue(const string &s) {
+  auto parameter = this->parameter.lock();
+  parameter->eraseValueIndex(*this);
   value_string = s;
   value_type = type_string;
+  parameter->insertValueIndex(shared_from_this());
+  markDirty();
 }
 
 ostream &ParameterValue::output(ostream &os, int level) const {
@@ -85,13 +103,24 @@ ostream &ParameterValue::output(ostream &os, int level) const {
 
 void ParameterValue::write(const H5::CommonFG &loc,
                            const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", parameter.lock()->project.lock()->enumtype,
                       "ParameterValue");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "parameter", parent,
-                     string("project/parameters/") + parameter.lock()->name);
+  // The link to the parameter is kept in the lean layout since configurations
+  // use it to identify the parameter of a value
+  H5::createHardLink(group, "parameter", parent, ".");
+  writeValue(group);
+  if (parameter.lock()->project.lock()->layout == Project::layout_full)
+    group.createGroup("configurations");
+}
+
+void ParameterValue::insert(const shared_ptr<Configuration> &configuration) {
+  checked_emplace(configurations, configuration->name, configuration);
+}
+
+void ParameterValue::writeValue(const H5::Group &group) const {
   switch (value_type) {
   case type_empty:
     // do nothing
@@ -108,10 +137,15 @@ void ParameterValue::write(const H5::CommonFG &loc,
   default:
     assert(0);
   }
-  group.createGroup("configurations");
 }
 
-void ParameterValue::insert(const shared_ptr<Configuration> &configuration) {
-  checked_emplace(configurations, configuration->name, configuration);
+void ParameterValue::append(const H5::CommonFG &loc,
+                            const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  // The value may have been modified
+  if (group.attrExists("data"))
+    group.removeAttr("data");
+  writeValue(group);
 }
 }
@@ -30,6 +30,10 @@ struct ParameterValue : Common, std::enable_shared_from_this<ParameterValue> {
   double value_double;
   string value_string;
 
+  virtual shared_ptr<const Common> getParent() const {
+    return parameter.lock();
+  }
+
   virtual bool invariant() const {
     return Common::invariant() && bool(parameter.lock()) &&
            parameter.lock()->parametervalues.count(name) &&
@@ -81,8 +85,12 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
 
 private:
+  void writeValue(const H5::Group &group) const;
+
   friend struct Configuration;
   void insert(const shared_ptr<Configuration> &configuration);
 };
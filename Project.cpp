@@ -1,18 +1,32 @@
 #include "Project.hpp"
 
+#include "Basis.hpp"
+#include "BasisVector.hpp"
 #include "Configuration.hpp"
+#include "CoordinateField.hpp"
 #include "CoordinateSystem.hpp"
+#include "DiscreteField.hpp"
+#include "DiscreteFieldBlock.hpp"
+#include "DiscreteFieldBlockComponent.hpp"
+#include "Discretization.hpp"
+#include "DiscretizationBlock.hpp"
 #include "Field.hpp"
 #include "Manifold.hpp"
 #include "Parameter.hpp"
+#include "ParameterValue.hpp"
+#include "Selection.hpp"
+#include "SubDiscretization.hpp"
 #include "TangentSpace.hpp"
+#include "TensorComponent.hpp"
 #include "TensorType.hpp"
 
 #include "H5Helpers.hpp"
 
 #include <algorithm>
+#include <future>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace SimulationIO {
@@ -25,20 +39,26 @@ using std::vector;
 
 shared_ptr<Project> createProject(const string &name) {
   auto project = Project::create(name);
-  assert(project->invariant());
+  assert(project->checkInvariant());
   return project;
 }
-shared_ptr<Project> readProject(const H5::CommonFG &loc) {
-  auto project = Project::create(loc);
-  assert(project->invariant());
+shared_ptr<Project> readProject(const H5::CommonFG &loc, bool metadata_only) {
+  auto project = Project::create(loc, metadata_only);
+  assert(project->checkInvariant());
   return project;
 }
 
-void Project::read(const H5::CommonFG &loc) {
+void Project::read(const H5::CommonFG &loc, bool metadata_only) {
   auto group = loc.openGroup(".");
-  createTypes(); // TODO: read from file
+  if (metadata_only)
+    read_location = group;
+  readTypes(group);
   assert(H5::readAttribute<string>(group, "type", enumtype) == "Project");
   H5::readAttribute(group, "name", name);
+  if (group.attrExists("layout")) {
+    assert(H5::readAttribute<string>(group, "layout") == "lean");
+    layout = layout_lean;
+  }
   H5::readGroup(group, "parameters",
                 [&](const H5::Group &group, const string &name) {
                   readParameter(group, name);
@@ -67,6 +87,9 @@ void Project::read(const H5::CommonFG &loc) {
                 [&](const H5::Group &group, const string &name) {
                   readCoordinateSystem(group, name);
                 });
+  // Entities that have just been read are not dirty
+  for (const auto &entity : allEntities())
+    entity->dirty = false;
 }
 
 void Project::createStandardTensorTypes() {
@@ -136,6 +159,155 @@ void Project::createStandardTensorTypes() {
   st4d->createTensorComponent("33", 9, {3, 3});
 }
 
+namespace {
+template <typename K, typename T>
+void collectEntities(vector<const Common *> &entities, const map<K, T> &m) {
+  for (const auto &p : m)
+    entities.push_back(p.second.get());
+}
+
+bool checkFullInvariants(const vector<const Common *> &entities, size_t begin,
+                         size_t end) {
+  bool inv = true;
+  for (size_t i = begin; i < end; ++i)
+    inv &= entities[i]->fullInvariant();
+  return inv;
+}
+}
+
+vector<const Common *> Project::allEntities() const {
+  vector<const Common *> entities;
+  entities.push_back(this);
+  collectEntities(entities, parameters);
+  for (const auto &par : parameters)
+    collectEntities(entities, par.second->parametervalues);
+  collectEntities(entities, configurations);
+  collectEntities(entities, tensortypes);
+  for (const auto &tt : tensortypes)
+    collectEntities(entities, tt.second->tensorcomponents);
+  collectEntities(entities, manifolds);
+  for (const auto &m : manifolds) {
+    collectEntities(entities, m.second->discretizations);
+    for (const auto &d : m.second->discretizations)
+      collectEntities(entities, d.second->discretizationblocks);
+    collectEntities(entities, m.second->subdiscretizations);
+  }
+  collectEntities(entities, tangentspaces);
+  for (const auto &ts : tangentspaces) {
+    collectEntities(entities, ts.second->bases);
+    for (const auto &b : ts.second->bases)
+      collectEntities(entities, b.second->basisvectors);
+  }
+  collectEntities(entities, fields);
+  for (const auto &f : fields) {
+    collectEntities(entities, f.second->discretefields);
+    for (const auto &df : f.second->discretefields) {
+      collectEntities(entities, df.second->discretefieldblocks);
+      for (const auto &dfb : df.second->discretefieldblocks)
+        collectEntities(entities, dfb.second->discretefieldblockcomponents);
+    }
+  }
+  collectEntities(entities, coordinatesystems);
+  for (const auto &cs : coordinatesystems)
+    collectEntities(entities, cs.second->coordinatefields);
+  return entities;
+}
+
+namespace {
+template <typename K, typename T>
+void indexEntities(std::unordered_map<string, weak_ptr<Common>> &index,
+                   const string &prefix, const map<K, T> &m) {
+  for (const auto &p : m)
+    index.emplace(prefix + p.second->name, p.second);
+}
+}
+
+void Project::buildPathIndex() const {
+  path_index.clear();
+  indexEntities(path_index, "parameters/", parameters);
+  for (const auto &par : parameters)
+    indexEntities(path_index,
+                  "parameters/" + par.second->name + "/parametervalues/",
+                  par.second->parametervalues);
+  indexEntities(path_index, "configurations/", configurations);
+  indexEntities(path_index, "tensortypes/", tensortypes);
+  for (const auto &tt : tensortypes)
+    indexEntities(path_index,
+                  "tensortypes/" + tt.second->name + "/tensorcomponents/",
+                  tt.second->tensorcomponents);
+  indexEntities(path_index, "manifolds/", manifolds);
+  for (const auto &m : manifolds) {
+    const auto mpath = "manifolds/" + m.second->name;
+    indexEntities(path_index, mpath + "/discretizations/",
+                  m.second->discretizations);
+    for (const auto &d : m.second->discretizations)
+      indexEntities(path_index, mpath + "/discretizations/" + d.second->name +
+                                    "/discretizationblocks/",
+                    d.second->discretizationblocks);
+    indexEntities(path_index, mpath + "/subdiscretizations/",
+                  m.second->subdiscretizations);
+  }
+  indexEntities(path_index, "tangentspaces/", tangentspaces);
+  for (const auto &ts : tangentspaces) {
+    const auto tspath = "tangentspaces/" + ts.second->name;
+    indexEntities(path_index, tspath + "/bases/", ts.second->bases);
+    for (const auto &b : ts.second->bases)
+      indexEntities(path_index,
+                    tspath + "/bases/" + b.second->name + "/basisvectors/",
+                    b.second->basisvectors);
+  }
+  indexEntities(path_index, "fields/", fields);
+  for (const auto &f : fields) {
+    indexEntities(path_index, "fields/" + f.second->name + "/discretefields/",
+                  f.second->discretefields);
+    for (const auto &df : f.second->discretefields) {
+      indexEntities(path_index, df.second->getPath() + "/discretefieldblocks/",
+                    df.second->discretefieldblocks);
+      for (const auto &dfb : df.second->discretefieldblocks)
+        indexEntities(path_index,
+                      dfb.second->getPath() + "/discretefieldblockcomponents/",
+                      dfb.second->discretefieldblockcomponents);
+    }
+  }
+  indexEntities(path_index, "coordinatesystems/", coordinatesystems);
+  for (const auto &cs : coordinatesystems)
+    indexEntities(path_index, "coordinatesystems/" + cs.second->name +
+                                  "/coordinatefields/",
+                  cs.second->coordinatefields);
+  path_index_valid = true;
+}
+
+shared_ptr<Common> Project::lookup(const string &path) const {
+  if (!path_index_valid)
+    buildPathIndex();
+  auto it = path_index.find(path);
+  if (it == path_index.end())
+    return nullptr;
+  return it->second.lock();
+}
+
+Selection Project::select() const { return Selection(shared_from_this()); }
+
+bool Project::validate(bool parallel) const {
+  const auto entities = allEntities();
+  const size_t nentities = entities.size();
+  const size_t nthreads =
+      parallel ? max(1U, std::thread::hardware_concurrency()) : 1;
+  if (nthreads == 1)
+    return checkFullInvariants(entities, 0, nentities);
+  // Checking invariants only reads entities, so that the checks can run
+  // concurrently
+  vector<std::future<bool>> results;
+  for (size_t n = 0; n < nthreads; ++n)
+    results.push_back(std::async(std::launch::async, checkFullInvariants,
+                                 std::cref(entities), nentities * n / nthreads,
+                                 nentities * (n + 1) / nthreads));
+  bool inv = true;
+  for (auto &result : results)
+    inv &= result.get();
+  return inv;
+}
+
 ostream &Project::output(ostream &os, int level) const {
   os << indent(level) << "Project " << quote(name) << "\n";
   for (const auto &par : parameters)
@@ -237,12 +409,33 @@ string itos(int d) {
 }
 }
 
+// Open the types that were committed when the project was written, so that
+// they are shared by all attributes and need not be created again
+void Project::readTypes(const H5::CommonFG &loc) const {
+  auto typegroup = loc.openGroup("types");
+  enumtype = typegroup.openEnumType("SimulationIO");
+  rangetype = typegroup.openCompType("Range");
+  pointtypes.clear();
+  boxtypes.clear();
+  regiontypes.clear();
+  for (int d = 0; d <= 4; ++d) {
+    pointtypes.push_back(
+        typegroup.openArrayType(string("Point[") + itos(d) + "]"));
+    boxtypes.push_back(typegroup.openCompType(string("Box[") + itos(d) + "]"));
+    regiontypes.push_back(
+        typegroup.openVarLenType(string("Region[") + itos(d) + "]"));
+  }
+}
+
 void Project::write(const H5::CommonFG &loc,
                     const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   // auto group = loc.createGroup(name);
   auto group = loc.openGroup(".");
-  createTypes();
+  // A type can be committed only once; recreate the types if they have
+  // already been written to or read from a file
+  if (enumtype.committed())
+    createTypes();
   auto typegroup = group.createGroup("types");
   enumtype.commit(typegroup, "SimulationIO");
   rangetype.commit(typegroup, "Range");
@@ -254,6 +447,15 @@ void Project::write(const H5::CommonFG &loc,
     regiontypes.at(d).commit(typegroup, string("Region[") + itos(d) + "]");
   H5::createAttribute(group, "type", enumtype, "Project");
   H5::createAttribute(group, "name", name);
+  // Start new data files when splitting
+  data_files.clear();
+  truncate_data_files = true;
+  split_index = 0;
+  // The full layout is the default and is not marked explicitly
+  if (layout == layout_lean) {
+    H5::createAttribute(group, "layout", "lean");
+    location = group;
+  }
   // no link to parent
   H5::createGroup(group, "parameters", parameters);
   H5::createGroup(group, "configurations", configurations);
@@ -262,12 +464,253 @@ void Project::write(const H5::CommonFG &loc,
   H5::createGroup(group, "tangentspaces", tangentspaces);
   H5::createGroup(group, "fields", fields);
   H5::createGroup(group, "coordinatesystems", coordinatesystems);
+  location = H5::Group();
+  // Datasets keep their data files open
+  data_files.clear();
+  truncate_data_files = false;
+  dirty = false;
+}
+
+void Project::append(const H5::CommonFG &loc,
+                     const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(".");
+  assert(H5::readAttribute<string>(group, "name") == name);
+  // The layout of a file cannot be changed
+  assert(group.attrExists("layout") == (layout == layout_lean));
+  if (layout == layout_lean)
+    location = group;
+  // Children are appended in the same order as they are written, so that
+  // links from new entities to other new entities can be resolved
+  H5::appendGroup(group, "parameters", parameters);
+  H5::appendGroup(group, "configurations", configurations);
+  H5::appendGroup(group, "tensortypes", tensortypes);
+  H5::appendGroup(group, "manifolds", manifolds);
+  H5::appendGroup(group, "tangentspaces", tangentspaces);
+  H5::appendGroup(group, "fields", fields);
+  H5::appendGroup(group, "coordinatesystems", coordinatesystems);
+  // Entities written while streaming still need the project group
+  location = layout == layout_lean && streaming() ? stream_location
+                                                  : H5::Group();
+  data_files.clear();
+  dirty = false;
+}
+
+H5::H5File Project::openDataFile(const DiscreteFieldBlockComponent &component,
+                                 const H5::H5Location &loc, hsize_t size,
+                                 string &filename) const {
+  assert(split != split_none);
+  // Data files are placed next to the project file
+  auto len = H5Fget_name(loc.getId(), nullptr, 0);
+  assert(len >= 0);
+  vector<char> buf(len + 1);
+  H5Fget_name(loc.getId(), buf.data(), buf.size());
+  string dirname, basename(buf.data());
+  auto slash = basename.rfind('/');
+  if (slash != string::npos) {
+    dirname = basename.substr(0, slash + 1);
+    basename = basename.substr(slash + 1);
+  }
+  const string suffix = ".s5";
+  if (basename.size() > suffix.size() &&
+      basename.compare(basename.size() - suffix.size(), suffix.size(),
+                       suffix) == 0)
+    basename.resize(basename.size() - suffix.size());
+  auto open = [&](const string &key) -> data_file_t & {
+    filename = basename + "." + key + suffix;
+    auto it = data_files.find(filename);
+    if (it == data_files.end()) {
+      const auto path = dirname + filename;
+      // Data files are recreated when writing, and extended when appending
+      data_file_t data_file;
+      if (!truncate_data_files && H5Fis_hdf5(path.c_str()) > 0) {
+        data_file.file = H5::H5File(path, H5F_ACC_RDWR);
+        data_file.size = data_file.file.getFileSize();
+      } else {
+        data_file.file = H5::H5File(path, H5F_ACC_TRUNC);
+        data_file.size = 0;
+      }
+      it = data_files.emplace(filename, data_file).first;
+    }
+    return it->second;
+  };
+  data_file_t *data_file = nullptr;
+  switch (split) {
+  case split_configuration:
+    data_file = &open(component.discretefieldblock.lock()
+                          ->discretefield.lock()
+                          ->configuration->name);
+    break;
+  case split_size:
+    // Begin a new data file when the current one would become too large
+    for (;;) {
+      data_file = &open(itos(split_index));
+      if (data_file->size == 0 || data_file->size + size <= split_size_cap)
+        break;
+      ++split_index;
+    }
+    break;
+  case split_custom:
+    data_file = &open(split_function(component));
+    break;
+  default:
+    assert(0);
+  }
+  data_file->size += size;
+  return data_file->file;
+}
+
+void Project::startStreaming(const H5::CommonFG &loc) {
+  assert(!streaming());
+  write(loc);
+  stream_location = loc.openGroup(".");
+  if (layout == layout_lean)
+    location = stream_location;
+}
+
+void Project::finishStreaming() {
+  assert(streaming());
+  append(stream_location);
+  stream_location = H5::Group();
+  location = H5::Group();
+}
+
+namespace {
+// Write an entity into a group of its parent unless it is already there;
+// returns whether it was written
+template <typename T>
+bool streamEntity(const H5::Group &parent, const string &groupname,
+                  const T &entity) {
+  auto group = parent.openGroup(groupname);
+  if (H5::pathExists(group, entity.name))
+    return false;
+  entity.write(group, parent);
+  entity.dirty = false;
+  return true;
+}
+}
+
+void Project::streamParameterValue(
+    const ParameterValue &parametervalue) const {
+  const auto &parameter = parametervalue.parameter.lock();
+  if (streamEntity(stream_location, "parameters", *parameter))
+    return;
+  streamEntity(stream_location.openGroup(string("parameters/") +
+                                         parameter->name),
+               "parametervalues", parametervalue);
+}
+
+void Project::streamConfiguration(const Configuration &configuration) const {
+  if (H5::pathExists(stream_location,
+                     string("configurations/") + configuration.name))
+    return;
+  for (const auto &val : configuration.parametervalues)
+    streamParameterValue(*val.second);
+  streamEntity(stream_location, "configurations", configuration);
+}
+
+void Project::streamTensorComponent(
+    const TensorComponent &tensorcomponent) const {
+  const auto &tensortype = tensorcomponent.tensortype.lock();
+  if (streamEntity(stream_location, "tensortypes", *tensortype))
+    return;
+  streamEntity(stream_location.openGroup(string("tensortypes/") +
+                                         tensortype->name),
+               "tensorcomponents", tensorcomponent);
+}
+
+void Project::streamManifold(const Manifold &manifold) const {
+  if (H5::pathExists(stream_location, string("manifolds/") + manifold.name))
+    return;
+  streamConfiguration(*manifold.configuration);
+  for (const auto &discretization : manifold.discretizations)
+    streamConfiguration(*discretization.second->configuration);
+  streamEntity(stream_location, "manifolds", manifold);
+}
+
+void Project::streamDiscretization(const Discretization &discretization) const {
+  const auto &manifold = discretization.manifold.lock();
+  if (!H5::pathExists(stream_location,
+                      string("manifolds/") + manifold->name)) {
+    streamManifold(*manifold);
+    return;
+  }
+  const auto parent =
+      stream_location.openGroup(string("manifolds/") + manifold->name);
+  if (H5::pathExists(parent, string("discretizations/") + discretization.name))
+    return;
+  streamConfiguration(*discretization.configuration);
+  streamEntity(parent, "discretizations", discretization);
+}
+
+void Project::streamDiscretizationBlock(
+    const DiscretizationBlock &discretizationblock) const {
+  const auto &discretization = discretizationblock.discretization.lock();
+  const auto path = string("manifolds/") +
+                    discretization->manifold.lock()->name +
+                    "/discretizations/" + discretization->name;
+  if (!H5::pathExists(stream_location, path)) {
+    streamDiscretization(*discretization);
+    return;
+  }
+  streamEntity(stream_location.openGroup(path), "discretizationblocks",
+               discretizationblock);
+}
+
+void Project::streamTangentSpace(const TangentSpace &tangentspace) const {
+  if (H5::pathExists(stream_location,
+                     string("tangentspaces/") + tangentspace.name))
+    return;
+  streamConfiguration(*tangentspace.configuration);
+  for (const auto &basis : tangentspace.bases)
+    streamConfiguration(*basis.second->configuration);
+  streamEntity(stream_location, "tangentspaces", tangentspace);
+}
+
+void Project::streamBasis(const Basis &basis) const {
+  const auto &tangentspace = basis.tangentspace.lock();
+  if (!H5::pathExists(stream_location,
+                      string("tangentspaces/") + tangentspace->name)) {
+    streamTangentSpace(*tangentspace);
+    return;
+  }
+  const auto parent =
+      stream_location.openGroup(string("tangentspaces/") + tangentspace->name);
+  if (H5::pathExists(parent, string("bases/") + basis.name))
+    return;
+  streamConfiguration(*basis.configuration);
+  streamEntity(parent, "bases", basis);
+}
+
+void Project::streamField(const Field &field) const {
+  if (H5::pathExists(stream_location, string("fields/") + field.name))
+    return;
+  streamConfiguration(*field.configuration);
+  streamManifold(*field.manifold);
+  streamTangentSpace(*field.tangentspace);
+  streamEntity(stream_location, "tensortypes", *field.tensortype);
+  // A new field is written with everything it contains
+  for (const auto &df : field.discretefields) {
+    const auto &discretefield = df.second;
+    streamConfiguration(*discretefield->configuration);
+    streamDiscretization(*discretefield->discretization);
+    streamBasis(*discretefield->basis);
+    for (const auto &dfb : discretefield->discretefieldblocks) {
+      const auto &discretefieldblock = dfb.second;
+      streamDiscretizationBlock(*discretefieldblock->discretizationblock);
+      for (const auto &dfbd : discretefieldblock->discretefieldblockcomponents)
+        streamTensorComponent(*dfbd.second->tensorcomponent);
+    }
+  }
+  streamEntity(stream_location, "fields", field);
 }
 
 shared_ptr<Parameter> Project::createParameter(const string &name) {
   auto parameter = Parameter::create(name, shared_from_this());
   checked_emplace(parameters, parameter->name, parameter);
-  assert(parameter->invariant());
+  insertPath(*this, "parameters", parameter);
+  parameter->markDirty();
+  assert(parameter->checkInvariant());
   return parameter;
 }
 
@@ -275,14 +718,17 @@ shared_ptr<Parameter> Project::readParameter(const H5::CommonFG &loc,
                                              const string &entry) {
   auto parameter = Parameter::create(loc, entry, shared_from_this());
   checked_emplace(parameters, parameter->name, parameter);
-  assert(parameter->invariant());
+  insertPath(*this, "parameters", parameter);
+  assert(parameter->checkInvariant());
   return parameter;
 }
 
 shared_ptr<Configuration> Project::createConfiguration(const string &name) {
   auto configuration = Configuration::create(name, shared_from_this());
   checked_emplace(configurations, configuration->name, configuration);
-  assert(configuration->invariant());
+  insertPath(*this, "configurations", configuration);
+  configuration->markDirty();
+  assert(configuration->checkInvariant());
   return configuration;
 }
 
@@ -290,7 +736,8 @@ shared_ptr<Configuration> Project::readConfiguration(const H5::CommonFG &loc,
                                                      const string &entry) {
   auto configuration = Configuration::create(loc, entry, shared_from_this());
   checked_emplace(configurations, configuration->name, configuration);
-  assert(configuration->invariant());
+  insertPath(*this, "configurations", configuration);
+  assert(configuration->checkInvariant());
   return configuration;
 }
 
@@ -299,7 +746,9 @@ shared_ptr<TensorType> Project::createTensorType(const string &name,
   auto tensortype =
       TensorType::create(name, shared_from_this(), dimension, rank);
   checked_emplace(tensortypes, tensortype->name, tensortype);
-  assert(tensortype->invariant());
+  insertPath(*this, "tensortypes", tensortype);
+  tensortype->markDirty();
+  assert(tensortype->checkInvariant());
   return tensortype;
 }
 
@@ -307,7 +756,8 @@ shared_ptr<TensorType> Project::readTensorType(const H5::CommonFG &loc,
                                                const string &entry) {
   auto tensortype = TensorType::create(loc, entry, shared_from_this());
   checked_emplace(tensortypes, tensortype->name, tensortype);
-  assert(tensortype->invariant());
+  insertPath(*this, "tensortypes", tensortype);
+  assert(tensortype->checkInvariant());
   return tensortype;
 }
 
@@ -318,7 +768,9 @@ Project::createManifold(const string &name,
   auto manifold =
       Manifold::create(name, shared_from_this(), configuration, dimension);
   checked_emplace(manifolds, manifold->name, manifold);
-  assert(manifold->invariant());
+  insertPath(*this, "manifolds", manifold);
+  manifold->markDirty();
+  assert(manifold->checkInvariant());
   return manifold;
 }
 
@@ -326,7 +778,8 @@ shared_ptr<Manifold> Project::readManifold(const H5::CommonFG &loc,
                                            const string &entry) {
   auto manifold = Manifold::create(loc, entry, shared_from_this());
   checked_emplace(manifolds, manifold->name, manifold);
-  assert(manifold->invariant());
+  insertPath(*this, "manifolds", manifold);
+  assert(manifold->checkInvariant());
   return manifold;
 }
 
@@ -337,7 +790,9 @@ Project::createTangentSpace(const string &name,
   auto tangentspace =
       TangentSpace::create(name, shared_from_this(), configuration, dimension);
   checked_emplace(tangentspaces, tangentspace->name, tangentspace);
-  assert(tangentspace->invariant());
+  insertPath(*this, "tangentspaces", tangentspace);
+  tangentspace->markDirty();
+  assert(tangentspace->checkInvariant());
   return tangentspace;
 }
 
@@ -345,7 +800,8 @@ shared_ptr<TangentSpace> Project::readTangentSpace(const H5::CommonFG &loc,
                                                    const string &entry) {
   auto tangentspace = TangentSpace::create(loc, entry, shared_from_this());
   checked_emplace(tangentspaces, tangentspace->name, tangentspace);
-  assert(tangentspace->invariant());
+  insertPath(*this, "tangentspaces", tangentspace);
+  assert(tangentspace->checkInvariant());
   return tangentspace;
 }
 
@@ -358,7 +814,9 @@ Project::createField(const string &name,
   auto field = Field::create(name, shared_from_this(), configuration, manifold,
                              tangentspace, tensortype);
   checked_emplace(fields, field->name, field);
-  assert(field->invariant());
+  insertPath(*this, "fields", field);
+  field->markDirty();
+  assert(field->checkInvariant());
   return field;
 }
 
@@ -366,7 +824,8 @@ shared_ptr<Field> Project::readField(const H5::CommonFG &loc,
                                      const string &entry) {
   auto field = Field::create(loc, entry, shared_from_this());
   checked_emplace(fields, field->name, field);
-  assert(field->invariant());
+  insertPath(*this, "fields", field);
+  assert(field->checkInvariant());
   return field;
 }
 
@@ -377,7 +836,9 @@ Project::createCoordinateSystem(const string &name,
   auto coordinatesystem = CoordinateSystem::create(name, shared_from_this(),
                                                    configuration, manifold);
   checked_emplace(coordinatesystems, coordinatesystem->name, coordinatesystem);
-  assert(coordinatesystem->invariant());
+  insertPath(*this, "coordinatesystems", coordinatesystem);
+  coordinatesystem->markDirty();
+  assert(coordinatesystem->checkInvariant());
   return coordinatesystem;
 }
 
@@ -386,7 +847,8 @@ Project::readCoordinateSystem(const H5::CommonFG &loc, const string &entry) {
   auto coordinatesystem =
       CoordinateSystem::create(loc, entry, shared_from_this());
   checked_emplace(coordinatesystems, coordinatesystem->name, coordinatesystem);
-  assert(coordinatesystem->invariant());
+  insertPath(*this, "coordinatesystems", coordinatesystem);
+  assert(coordinatesystem->checkInvariant());
   return coordinatesystem;
 }
 }
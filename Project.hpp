@@ -7,33 +7,48 @@
 
 #include "RegionCalculus.hpp"
 
+#include <functional>
 #include <iostream>
+#include <list>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace SimulationIO {
 
+using std::list;
 using std::make_shared;
 using std::map;
 using std::ostream;
 using std::shared_ptr;
 using std::string;
 using std::vector;
+using std::weak_ptr;
 
 struct Project;
 
 shared_ptr<Project> createProject(const string &name);
-shared_ptr<Project> readProject(const H5::CommonFG &loc);
+// When reading metadata only, datasets are not opened while reading; they are
+// opened on first use instead
+shared_ptr<Project> readProject(const H5::CommonFG &loc,
+                                bool metadata_only = false);
 
+struct Basis;
 struct Parameter;
+struct ParameterValue;
 struct Configuration;
 struct CoordinateSystem;
+struct DiscreteFieldBlockComponent;
+struct Discretization;
+struct DiscretizationBlock;
+struct TensorComponent;
 struct TensorType;
 struct Manifold;
 struct TangentSpace;
 struct Field;
+struct Selection;
 // struct CoordinateSystem;
 // struct CoordinateBasis;
 
@@ -47,6 +62,25 @@ struct Project : Common, std::enable_shared_from_this<Project> {
   map<string, shared_ptr<CoordinateSystem>> coordinatesystems; // children
   // TODO: coordinatebasis
 
+  // On-disk layout. The full layout stores every link in both directions. The
+  // lean layout omits all links that can be derived from the group hierarchy
+  // (links to the parent, and back-links in referenced objects); these are
+  // reconstructed in memory when reading.
+  enum layout_t { layout_full, layout_lean };
+  layout_t layout;
+
+  // Splitting output. When splitting, datasets are written into separate data
+  // files next to the project file, which then contains only metadata and
+  // external links. Data files are named after the project file, e.g.
+  // "output.conf1.s5" when splitting "output.s5" by configuration.
+  enum split_t { split_none, split_configuration, split_size, split_custom };
+  split_t split;
+  // Approximate maximum size of a data file in bytes when splitting by size
+  hsize_t split_size_cap;
+  // Name of the data file (without the project file name) for a component
+  // when splitting in a custom way, e.g. by the process owning its block
+  std::function<string(const DiscreteFieldBlockComponent &)> split_function;
+
   mutable H5::EnumType enumtype;
   mutable H5::CompType rangetype;
 
@@ -54,30 +88,120 @@ struct Project : Common, std::enable_shared_from_this<Project> {
   mutable vector<H5::CompType> boxtypes;
   mutable vector<H5::VarLenType> regiontypes;
 
+  // Project group; only valid while writing in the lean layout
+  mutable H5::Group location;
+
+  // Project group in the file the project was read from; only valid when
+  // reading metadata only. Datasets are opened from there on demand.
+  H5::Group read_location;
+  // Datasets opened on demand, least recently used first. Datasets beyond the
+  // most recent max_open_datasets are closed again.
+  int max_open_datasets;
+  mutable list<weak_ptr<const DiscreteFieldBlockComponent>> open_datasets;
+
+  // Project group in the file that is being streamed to; only valid while
+  // streaming. Discrete fields, their blocks, and their components are
+  // written as soon as they are created while streaming.
+  H5::Group stream_location;
+
+private:
+  // Data files that have been opened while writing, by file name, with the
+  // (uncompressed) size of the datasets they contain
+  struct data_file_t {
+    H5::H5File file;
+    hsize_t size;
+  };
+  mutable map<string, data_file_t> data_files;
+  mutable bool truncate_data_files;
+  mutable int split_index;
+  // Open the data file for a component when splitting output, and return
+  // its name relative to the project file
+  friend struct DiscreteFieldBlockComponent;
+  H5::H5File openDataFile(const DiscreteFieldBlockComponent &component,
+                          const H5::H5Location &loc, hsize_t size,
+                          string &filename) const;
+
+public:
   virtual bool invariant() const { return Common::invariant(); }
+  // Check the full invariants of the project and all entities it contains,
+  // optionally using multiple threads
+  bool validate(bool parallel = false) const;
+
+  // Look up an entity by its path in the file relative to the project, e.g.
+  // "fields/F/discretefields/D". Returns a null pointer if there is no such
+  // entity. Paths are resolved via an index that is built on the first
+  // lookup, and is then kept up to date as entities are created, read, and
+  // released.
+  shared_ptr<Common> lookup(const string &path) const;
+  template <typename T> shared_ptr<T> lookup(const string &path) const {
+    return std::dynamic_pointer_cast<T>(lookup(path));
+  }
+
+  // Start a query over the discrete fields of this project
+  Selection select() const;
 
+private:
+  vector<const Common *> allEntities() const;
+
+  mutable std::unordered_map<string, weak_ptr<Common>> path_index;
+  mutable bool path_index_valid;
+  void buildPathIndex() const;
+  // Paths are relative to the project
+  string getPath() const { return string(); }
+  // Add a newly created or read entity to the path index
+  template <typename T>
+  void insertPath(const T &parent, const string &groupname,
+                  const shared_ptr<Common> &entity) const {
+    if (!path_index_valid)
+      return;
+    const string parentpath = parent.getPath();
+    path_index.emplace((parentpath.empty() ? "" : parentpath + "/") +
+                           groupname + "/" + entity->name,
+                       entity);
+  }
+  void erasePath(const string &path) const { path_index.erase(path); }
+  friend struct Basis;
+  friend struct CoordinateSystem;
+  friend struct DiscreteField;
+  friend struct DiscreteFieldBlock;
+  friend struct Discretization;
+  friend struct Field;
+  friend struct Manifold;
+  friend struct Parameter;
+  friend struct TangentSpace;
+  friend struct TensorType;
+
+public:
   Project(const Project &) = delete;
   Project(Project &&) = delete;
   Project &operator=(const Project &) = delete;
   Project &operator=(Project &&) = delete;
 
   friend shared_ptr<Project> createProject(const string &name);
-  friend shared_ptr<Project> readProject(const H5::CommonFG &loc);
-  Project(hidden, const string &name) : Common(name) { createTypes(); }
-  Project(hidden) : Common(hidden()) {}
+  friend shared_ptr<Project> readProject(const H5::CommonFG &loc,
+                                         bool metadata_only);
+  Project(hidden, const string &name)
+      : Common(name), layout(layout_full), split(split_none),
+        split_size_cap(hsize_t(1) << 30), max_open_datasets(100),
+        truncate_data_files(false), split_index(0), path_index_valid(false) {
+    createTypes();
+  }
+  Project(hidden)
+      : Common(hidden()), layout(layout_full), split(split_none),
+        split_size_cap(hsize_t(1) << 30), max_open_datasets(100),
+        truncate_data_files(false), split_index(0), path_index_valid(false) {}
 
 private:
   static shared_ptr<Project> create(const string &name) {
-    auto project = make_shared<Project>(hidden(), name);
-    project->createTypes();
-    return project;
+    return make_shared<Project>(hidden(), name);
   }
-  static shared_ptr<Project> create(const H5::CommonFG &loc) {
+  static shared_ptr<Project> create(const H5::CommonFG &loc,
+                                    bool metadata_only) {
     auto project = make_shared<Project>(hidden());
-    project->read(loc);
+    project->read(loc, metadata_only);
     return project;
   }
-  void read(const H5::CommonFG &loc);
+  void read(const H5::CommonFG &loc, bool metadata_only);
 
 public:
   virtual ~Project() {}
@@ -93,12 +217,45 @@ private:
   static void insertEnumField(const H5::EnumType &type, const string &name,
                               int value);
   void createTypes() const;
+  void readTypes(const H5::CommonFG &loc) const;
 
 public:
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
   void write(const H5::CommonFG &loc) const { write(loc, H5::H5File()); }
+  // Write only those entities that are not yet present in a file to which
+  // this project has already been written (or from which it has been read),
+  // and update those that have been modified since. Entities that are not
+  // dirty, and all entities they contain, are skipped.
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  void append(const H5::CommonFG &loc) const { append(loc, H5::H5File()); }
+  // Checkpoint a project into the file it was last written to
+  void writeIncremental(const H5::CommonFG &loc) const { append(loc); }
+  // Write the project, and keep writing new entities to the file as they are
+  // created until streaming is finished. Entities that have been written can
+  // then be released from memory.
+  void startStreaming(const H5::CommonFG &loc);
+  // Write all remaining new entities and stop streaming
+  void finishStreaming();
+  bool streaming() const { return H5Iis_valid(stream_location.getId()) > 0; }
 
+private:
+  // While streaming, write an entity that a newly created entity links to if
+  // it is not yet in the file, after the entities it links to in turn. Only
+  // the missing entities are written, not the whole project.
+  void streamParameterValue(const ParameterValue &parametervalue) const;
+  void streamConfiguration(const Configuration &configuration) const;
+  void streamTensorComponent(const TensorComponent &tensorcomponent) const;
+  void streamManifold(const Manifold &manifold) const;
+  void streamDiscretization(const Discretization &discretization) const;
+  void streamDiscretizationBlock(
+      const DiscretizationBlock &discretizationblock) const;
+  void streamTangentSpace(const TangentSpace &tangentspace) const;
+  void streamBasis(const Basis &basis) const;
+  void streamField(const Field &field) const;
+
+public:
   shared_ptr<Parameter> createParameter(const string &name);
   shared_ptr<Parameter> readParameter(const H5::CommonFG &loc,
                                       const string &entry);
@@ -5,15 +5,26 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#ifndef REGIONCALCULUS_DEBUG
 #define REGIONCALCULUS_DEBUG 1
+#endif
 
 namespace RegionCalculus {
 
@@ -42,6 +53,15 @@ template <> struct largeint<unsigned short> {
 };
 template <> struct largeint<unsigned int> { typedef unsigned long long type; };
 template <> struct largeint<unsigned long> { typedef unsigned long long type; };
+
+// Integer division rounding down and up, for positive divisors
+template <typename T> T div_floor(const T &x, const T &y) {
+  assert(y > 0);
+  return x >= 0 ? x / y : -((-x + y - 1) / y);
+}
+template <typename T> T div_ceil(const T &x, const T &y) {
+  return -div_floor(-x, y);
+}
 }
 
 template <typename T, int D> struct point {
@@ -410,6 +430,35 @@ template <typename T, int D> struct box {
   box operator<<(const point<T, D> &p) const { return box(*this) <<= p; }
   box operator*(const point<T, D> &p) const { return box(*this) *= p; }
 
+  // Morphological operators
+  box grow(const point<T, D> &dlo, const point<T, D> &dhi) const {
+    if (empty())
+      return *this;
+    return box(lo - dlo, hi + dhi);
+  }
+  box grow(const T &n) const { return grow(point<T, D>(n), point<T, D>(n)); }
+  box shrink(const point<T, D> &dlo, const point<T, D> &dhi) const {
+    return grow(-dlo, -dhi);
+  }
+  box shrink(const T &n) const { return grow(-n); }
+  // The smallest box on the coarse grid covering this box, where each
+  // coarse point covers f fine points
+  box coarsen(const point<T, D> &f) const {
+    if (empty())
+      return *this;
+    point<T, D> clo, chi;
+    for (int d = 0; d < D; ++d) {
+      clo[d] = detail::div_floor(lo[d], f[d]);
+      chi[d] = detail::div_ceil(hi[d], f[d]);
+    }
+    return box(clo, chi);
+  }
+  // Each point becomes f fine points
+  box refine(const point<T, D> &f) const {
+    assert(all(f > point<T, D>(0)));
+    return *this * f;
+  }
+
   // Comparison operators
   bool operator==(const box &b) const {
     if (empty() && b.empty())
@@ -613,6 +662,8 @@ template <typename T, int D> struct less<RegionCalculus::box<T, D>> {
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace RegionCalculus {
+template <typename T, int D> struct region2;
+
 template <typename T, int D> struct region {
   vector<box<T, D>> boxes;
   region() = default;
@@ -654,6 +705,25 @@ private:
     std::sort(boxes.begin(), boxes.end(), std::less<box<T, D>>());
   }
 
+  // Set operations between regions sweep over both regions via their
+  // region2 representation. This also yields a canonical set of boxes.
+  region2<T, D> sweep() const { return region2<T, D>::from_disjoint(boxes); }
+  region(const region2<T, D> &r) : boxes(r) {
+#if REGIONCALCULUS_DEBUG
+    assert(invariant());
+#endif
+  }
+  typedef region2<T, D> (region2<T, D>::*region2_operator_t)(
+      const region2<T, D> &, bool) const;
+  region sweep_operator(region2_operator_t op, const region &r,
+                        bool parallel) const {
+    if (!parallel)
+      return region((sweep().*op)(r.sweep(), false));
+    auto other = std::async(std::launch::async, [&]() { return r.sweep(); });
+    const auto self = sweep();
+    return region((self.*op)(other.get(), true));
+  }
+
 public:
   // Invariant
   bool invariant() const {
@@ -688,6 +758,41 @@ public:
     return r;
   }
 
+  // Shift operators
+  region &operator>>=(const point<T, D> &p) {
+    for (auto &b : boxes)
+      b >>= p;
+    return *this;
+  }
+  region &operator<<=(const point<T, D> &p) {
+    for (auto &b : boxes)
+      b <<= p;
+    return *this;
+  }
+  region operator>>(const point<T, D> &p) const { return region(*this) >>= p; }
+  region operator<<(const point<T, D> &p) const { return region(*this) <<= p; }
+
+  // Morphological operators, see region2. The results are normalized in
+  // the same way as the results of set operations.
+  region grow(const point<T, D> &dlo, const point<T, D> &dhi) const {
+    return region(sweep().grow(dlo, dhi));
+  }
+  region grow(const T &n) const { return region(sweep().grow(n)); }
+  region shrink(const point<T, D> &dlo, const point<T, D> &dhi) const {
+    return region(sweep().shrink(dlo, dhi));
+  }
+  region shrink(const T &n) const { return region(sweep().shrink(n)); }
+  region coarsen(const point<T, D> &f) const {
+    return region(sweep().coarsen(f));
+  }
+  region refine(const point<T, D> &f) const {
+    vector<box<T, D>> bs;
+    bs.reserve(boxes.size());
+    for (const auto &b : boxes)
+      bs.push_back(b.refine(f));
+    return region(std::move(bs));
+  }
+
   region operator&(const box<T, D> &b) const {
     region nr;
     for (const auto &rb : boxes) {
@@ -701,18 +806,13 @@ public:
 #endif
     return nr;
   }
-  region operator&(const region &r) const {
-    region nr;
-    for (const auto &b : r.boxes)
-      nr.append(*this & b);
-    nr.normalize();
-#if REGIONCALCULUS_DEBUG
-    assert(invariant());
-#endif
-    return nr;
-  }
+  region operator&(const region &r) const { return intersection(r); }
   region intersection(const box<T, D> &b) const { return *this & b; }
-  region intersection(const region &r) const { return *this & r; }
+  // When parallel is set, the sweeps and large set operations are
+  // executed concurrently
+  region intersection(const region &r, bool parallel = false) const {
+    return sweep_operator(&region2<T, D>::intersection, r, parallel);
+  }
 
   region operator-(const box<T, D> &b) const {
     region nr;
@@ -724,40 +824,21 @@ public:
 #endif
     return nr;
   }
-  region operator-(const region &r) const {
-    region nr = *this;
-    for (const auto &b : r.boxes)
-      nr = nr - b;
-    nr.normalize();
-#if REGIONCALCULUS_DEBUG
-    assert(invariant());
-#endif
-    return nr;
-  }
+  region operator-(const region &r) const { return difference(r); }
   region difference(const box<T, D> &b) const { return *this - b; }
-  region difference(const region &r) const { return *this - r; }
+  region difference(const region &r, bool parallel = false) const {
+    return sweep_operator(&region2<T, D>::difference, r, parallel);
+  }
 
-  region operator|(const region &r) const {
-    region nr = *this - r;
-    nr.append(r);
-    nr.normalize();
-#if REGIONCALCULUS_DEBUG
-    assert(invariant());
-#endif
-    return nr;
+  region operator|(const region &r) const { return setunion(r); }
+  region setunion(const region &r, bool parallel = false) const {
+    return sweep_operator(&region2<T, D>::setunion, r, parallel);
   }
-  region setunion(const region &r) const { return *this | r; }
 
-  region operator^(const region &r) const {
-    region nr = *this - r;
-    nr.append(r - *this);
-    nr.normalize();
-#if REGIONCALCULUS_DEBUG
-    assert(invariant());
-#endif
-    return nr;
+  region operator^(const region &r) const { return symmetric_difference(r); }
+  region symmetric_difference(const region &r, bool parallel = false) const {
+    return sweep_operator(&region2<T, D>::symmetric_difference, r, parallel);
   }
-  region symmetric_difference(const region &r) const { return *this ^ r; }
 
   // Set comparison operators
   bool contains(const point<T, D> &p) const {
@@ -821,31 +902,449 @@ template <typename T, int D> struct less<RegionCalculus::region<T, D>> {
 };
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Iteration
+////////////////////////////////////////////////////////////////////////////////
+
+namespace RegionCalculus {
+
+// Points are traversed in memory order, i.e. direction 0 varies fastest.
+// Each row in direction 0 is a contiguous run, so that kernels working on
+// runs can be vectorized.
+
+// The linear index of the point p in the box within
+template <typename T, int D>
+std::ptrdiff_t linear_index(const point<T, D> &p, const box<T, D> &within) {
+  assert(within.contains(p));
+  const point<T, D> within_lo = within.lower(), within_shape = within.shape();
+  std::ptrdiff_t idx = 0;
+  for (int d = D - 1; d >= 0; --d)
+    idx = idx * within_shape[d] + (p[d] - within_lo[d]);
+  return idx;
+}
+
+// Call f(p, idx, n) for each run of the box b, where p is the first point
+// of the run, idx is the linear index of p in the box within (which needs
+// to contain b), and n is the length of the run
+template <typename T, int D, typename F>
+void for_each_run(const box<T, D> &b, const box<T, D> &within, const F &f) {
+  if (b.empty())
+    return;
+  assert(b <= within);
+  const point<T, D> lo = b.lower(), hi = b.upper();
+  const point<T, D> within_lo = within.lower(), within_shape = within.shape();
+  array<std::ptrdiff_t, D> strides;
+  std::ptrdiff_t stride = 1;
+  for (int d = 0; d < D; ++d) {
+    strides[d] = stride;
+    stride *= within_shape[d];
+  }
+  const T n = D == 0 ? T(1) : hi[0] - lo[0];
+  point<T, D> p = lo;
+  for (;;) {
+    std::ptrdiff_t idx = 0;
+    for (int d = 0; d < D; ++d)
+      idx += (p[d] - within_lo[d]) * strides[d];
+    f(p, idx, n);
+    // Step to the next run
+    int d = 1;
+    for (; d < D; ++d) {
+      if (++p[d] < hi[d])
+        break;
+      p[d] = lo[d];
+    }
+    if (d >= D)
+      break;
+  }
+}
+template <typename T, int D, typename F>
+void for_each_run(const region<T, D> &r, const box<T, D> &within,
+                  const F &f) {
+  for (const auto &b : r.boxes)
+    for_each_run(b, within, f);
+}
+
+// Call f(p, idx) for each point p of the box b, where idx is the linear
+// index of p in the box within
+template <typename T, int D, typename F>
+void for_each_linear(const box<T, D> &b, const box<T, D> &within,
+                     const F &f) {
+  for_each_run(b, within, [&](const point<T, D> &p, std::ptrdiff_t idx,
+                              const T n) {
+    point<T, D> q = p;
+    for (T i = 0; i < n; ++i) {
+      f(q, idx + i);
+      if (D > 0)
+        ++q[0];
+    }
+  });
+}
+template <typename T, int D, typename F>
+void for_each_linear(const region<T, D> &r, const box<T, D> &within,
+                     const F &f) {
+  for (const auto &b : r.boxes)
+    for_each_linear(b, within, f);
+}
+
+// Call f(p) for each point p of the box or region
+template <typename T, int D, typename F>
+void for_each(const box<T, D> &b, const F &f) {
+  for_each_linear(b, b, [&](const point<T, D> &p, std::ptrdiff_t) { f(p); });
+}
+template <typename T, int D, typename F>
+void for_each(const region<T, D> &r, const F &f) {
+  for (const auto &b : r.boxes)
+    for_each(b, f);
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Space-filling curves
+////////////////////////////////////////////////////////////////////////////////
+
+namespace RegionCalculus {
+
+// Ordering boxes along a space-filling curve keeps spatially nearby boxes
+// close to each other in the ordering. This improves locality when boxes
+// are distributed over processes or written to a file.
+enum class sfc_t { morton, hilbert };
+
+// The index of the point x along a space-filling curve on a grid of
+// 2^nbits points in each direction. All coordinates need to lie in
+// [0, 2^nbits), and D * nbits must not exceed 64.
+template <int D>
+std::uint64_t sfc_index(array<std::uint64_t, D> x, int nbits,
+                        sfc_t curve = sfc_t::hilbert) {
+  assert(nbits >= 1 && D * nbits <= 64);
+  if (curve == sfc_t::hilbert && D > 1) {
+    // Transpose the coordinates into the Hilbert index, see J. Skilling,
+    // "Programming the Hilbert curve", AIP Conf. Proc. 707, 381 (2004)
+    const std::uint64_t m = std::uint64_t(1) << (nbits - 1);
+    for (std::uint64_t q = m; q > 1; q >>= 1) {
+      const std::uint64_t p = q - 1;
+      for (int d = 0; d < D; ++d) {
+        if (x[d] & q) {
+          x[0] ^= p;
+        } else {
+          const std::uint64_t t = (x[0] ^ x[d]) & p;
+          x[0] ^= t;
+          x[d] ^= t;
+        }
+      }
+    }
+    // Gray encode
+    for (int d = 1; d < D; ++d)
+      x[d] ^= x[d - 1];
+    std::uint64_t t = 0;
+    for (std::uint64_t q = m; q > 1; q >>= 1)
+      if (x[D - 1] & q)
+        t ^= q - 1;
+    for (int d = 0; d < D; ++d)
+      x[d] ^= t;
+  }
+  // Interleave the bits, most significant first
+  std::uint64_t idx = 0;
+  for (int b = nbits - 1; b >= 0; --b)
+    for (int d = 0; d < D; ++d)
+      idx = (idx << 1) | ((x[d] >> b) & 1);
+  return idx;
+}
+
+// The permutation that sorts the boxes along a space-filling curve. Boxes
+// are located by their centres; the curve is scaled to cover the bounding
+// box of all centres.
+template <typename T, int D>
+vector<std::size_t> sfc_order(const vector<box<T, D>> &bs,
+                              sfc_t curve = sfc_t::hilbert) {
+  // Use twice the centres, which are integers
+  vector<point<T, D>> centres;
+  centres.reserve(bs.size());
+  for (const auto &b : bs)
+    centres.push_back(b.lo + b.hi);
+  point<T, D> lo, hi;
+  if (!centres.empty())
+    lo = hi = centres.front();
+  for (const auto &c : centres)
+    for (int d = 0; d < D; ++d) {
+      lo[d] = std::min(lo[d], c[d]);
+      hi[d] = std::max(hi[d], c[d]);
+    }
+  // Coarsen the coordinates until they fit onto the curve
+  const int nbits = D == 0 ? 1 : 64 / std::max(D, 1);
+  std::uint64_t extent = 0;
+  for (int d = 0; d < D; ++d)
+    extent = std::max(extent, std::uint64_t(hi[d] - lo[d]));
+  int shift = 0;
+  while (nbits < 64 && (extent >> shift) >= std::uint64_t(1) << nbits)
+    ++shift;
+  vector<std::uint64_t> keys;
+  keys.reserve(bs.size());
+  for (const auto &c : centres) {
+    array<std::uint64_t, D> x;
+    for (int d = 0; d < D; ++d)
+      x[d] = std::uint64_t(c[d] - lo[d]) >> shift;
+    keys.push_back(sfc_index<D>(x, nbits, curve));
+  }
+  vector<std::size_t> order(bs.size());
+  std::iota(order.begin(), order.end(), std::size_t(0));
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t i, std::size_t j) {
+                     return keys[i] < keys[j];
+                   });
+  return order;
+}
+
+// Sort the boxes along a space-filling curve
+template <typename T, int D>
+void sfc_sort(vector<box<T, D>> &bs, sfc_t curve = sfc_t::hilbert) {
+  const auto order = sfc_order(bs, curve);
+  vector<box<T, D>> sorted;
+  sorted.reserve(bs.size());
+  for (const auto i : order)
+    sorted.push_back(bs[i]);
+  bs = std::move(sorted);
+}
+
+// Split the box b into its first n points in memory order, which are
+// appended to head, and the remaining points, which are appended to tail.
+// Both parts are appended as at most D boxes each, in memory order.
+template <typename T, int D>
+void split_box(const box<T, D> &b, typename box<T, D>::prod_t n,
+               vector<box<T, D>> &head, vector<box<T, D>> &tail) {
+  typedef typename box<T, D>::prod_t prod_t;
+  const prod_t sz = b.size();
+  assert(n >= 0 && n <= sz);
+  if (n == 0) {
+    if (sz > 0)
+      tail.push_back(b);
+    return;
+  }
+  if (n == sz) {
+    head.push_back(b);
+    return;
+  }
+  // Peel off full hyperplanes, starting with the slowest direction
+  box<T, D> cur = b;
+  vector<box<T, D>> rest;
+  for (int d = D - 1; d >= 0 && n > 0; --d) {
+    const point<T, D> lo = cur.lo, hi = cur.hi;
+    const prod_t plane = cur.size() / (hi[d] - lo[d]);
+    const T m = T(n / plane);
+    n -= m * plane;
+    point<T, D> mid = lo;
+    mid[d] += m;
+    if (m > 0) {
+      point<T, D> head_hi = hi;
+      head_hi[d] = mid[d];
+      head.push_back(box<T, D>(lo, head_hi));
+    }
+    if (n == 0) {
+      cur = box<T, D>(mid, hi);
+    } else {
+      // Continue with the partially filled hyperplane
+      point<T, D> plane_hi = hi;
+      plane_hi[d] = mid[d] + 1;
+      point<T, D> rest_lo = mid;
+      rest_lo[d] = mid[d] + 1;
+      if (rest_lo[d] < hi[d])
+        rest.push_back(box<T, D>(rest_lo, hi));
+      cur = box<T, D>(mid, plane_hi);
+    }
+  }
+  if (!cur.empty())
+    rest.push_back(cur);
+  tail.insert(tail.end(), rest.rbegin(), rest.rend());
+}
+
+// Split the region r into npieces disjoint pieces whose sizes differ by at
+// most one point. Each piece is a contiguous section of a space-filling
+// curve through the boxes of r; boxes are split where necessary.
+template <typename T, int D>
+vector<region<T, D>> partition(const region<T, D> &r, int npieces,
+                               sfc_t curve = sfc_t::hilbert) {
+  typedef typename region<T, D>::prod_t prod_t;
+  assert(npieces > 0);
+  const auto order = sfc_order(r.boxes, curve);
+  const prod_t total = r.size();
+  vector<region<T, D>> pieces;
+  pieces.reserve(npieces);
+  // The remaining parts of the current box, last one first
+  vector<box<T, D>> todo;
+  std::size_t next = 0;
+  prod_t done = 0;
+  for (int k = 0; k < npieces; ++k) {
+    const prod_t end =
+        total / npieces * (k + 1) + std::min(prod_t(k + 1), total % npieces);
+    vector<box<T, D>> bs;
+    while (done < end) {
+      if (todo.empty())
+        todo.push_back(r.boxes[order[next++]]);
+      const box<T, D> b = todo.back();
+      todo.pop_back();
+      const prod_t want = end - done;
+      if (b.size() <= want) {
+        bs.push_back(b);
+        done += b.size();
+      } else {
+        vector<box<T, D>> tail;
+        split_box(b, want, bs, tail);
+        done += want;
+        todo.insert(todo.end(), tail.rbegin(), tail.rend());
+      }
+    }
+    pieces.push_back(region<T, D>(std::move(bs)));
+  }
+  assert(done == total && todo.empty() && next == r.boxes.size());
+  return pieces;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Chunking
+////////////////////////////////////////////////////////////////////////////////
+
+namespace RegionCalculus {
+
+// A regular grid of chunks, as used for chunked datasets. Chunk c covers
+// the box [origin + c * shape, origin + (c + 1) * shape).
+template <typename T, int D> struct chunk_grid {
+  point<T, D> origin, shape;
+
+  chunk_grid(const point<T, D> &origin, const point<T, D> &shape)
+      : origin(origin), shape(shape) {
+    assert(all(shape > point<T, D>(0)));
+  }
+
+  // The chunk containing the point p
+  point<T, D> chunk(const point<T, D> &p) const {
+    point<T, D> c;
+    for (int d = 0; d < D; ++d)
+      c[d] = detail::div_floor(p[d] - origin[d], shape[d]);
+    return c;
+  }
+  // The points covered by chunk c
+  box<T, D> chunk_box(const point<T, D> &c) const {
+    return box<T, D>(origin + c * shape, origin + (c + point<T, D>(1)) * shape);
+  }
+  // The chunks touched by the box b
+  box<T, D> chunks(const box<T, D> &b) const {
+    return (b << origin).coarsen(shape);
+  }
+};
+
+// Split the region r along chunk boundaries. The result lists the chunks
+// touched by r together with the boxes of r within each chunk, so that
+// I/O can be issued once per chunk. Chunks are ordered by their position
+// in storage order, i.e. with direction D-1 varying slowest.
+template <typename T, int D>
+vector<std::pair<point<T, D>, vector<box<T, D>>>>
+chunk_decomposition(const region<T, D> &r, const chunk_grid<T, D> &grid) {
+  map<point<T, D>, vector<box<T, D>>> chunks;
+  for (const auto &b : r.boxes)
+    for_each(grid.chunks(b), [&](const point<T, D> &c) {
+      chunks[c].push_back(b & grid.chunk_box(c));
+    });
+  vector<std::pair<point<T, D>, vector<box<T, D>>>> res;
+  res.reserve(chunks.size());
+  for (auto &chunk : chunks)
+    res.emplace_back(chunk.first, std::move(chunk.second));
+  return res;
+}
+}
+
 namespace RegionCalculus {
 template <typename T, int D> struct region2;
 
+// A region2 is stored in a flat, contiguous representation. A region2<T, D>
+// holds a sorted array of positions in direction D-1. The subregion at
+// position i (which is a region2<T, D-1>) describes the change of the
+// (D-1)-dimensional cross section at that position. The subregions of all
+// positions are stored one after the other in a single region2<T, D-1>
+// buffer, and offsets[i] marks the end of subregion i in that buffer.
+// Set operations sweep over these arrays without allocating tree nodes.
+//
+// The "range" functions below operate on entries [begin, end) of such a
+// buffer; a region2 object itself consists of all its entries.
+
 template <typename T> struct region2<T, 0> {
-  bool m_full;
+  // Whether the point is contained. When used as buffer for the subregions
+  // of a one-dimensional region2, this counts the stored subregions instead.
+  std::size_t m_count;
 
-  region2() : m_full(false) {}
+  region2() : m_count(0) {}
   region2(const region2 &) = default;
   region2(region2 &&) = default;
   region2 &operator=(const region2 &) = default;
   region2 &operator=(region2 &&) = default;
 
-  region2(const box<T, 0> &b) : m_full(true) {}
-  // region2(const point<T, 0> &p) : m_full(false) {}
-  explicit region2(bool b) : m_full(b) {}
-  template <typename U> region2(const region2<U, 0> &r) : m_full(r.m_full) {}
+  region2(const box<T, 0> &b) : m_count(1) {}
+  // region2(const point<T, 0> &p) : m_count(0) {}
+  explicit region2(bool b) : m_count(b) {}
+  template <typename U> region2(const region2<U, 0> &r) : m_count(r.m_count) {}
+  static region2 from_disjoint(const vector<box<T, 0>> &boxes) {
+    return region2(!boxes.empty());
+  }
+
+  // Buffer access
+  std::size_t nentries() const { return m_count; }
+  void clear() { m_count = 0; }
+  std::size_t capacity() const { return 0; }
+  static void append_range(region2 &res, const region2 &r, std::size_t begin,
+                           std::size_t end) {
+    res.m_count += end - begin;
+  }
+  template <typename F>
+  static void binary_range(const F &op, const region2 &r0, std::size_t begin0,
+                           std::size_t end0, const region2 &r1,
+                           std::size_t begin1, std::size_t end1,
+                           region2 &res) {
+    if (op(begin0 != end0, begin1 != end1))
+      ++res.m_count;
+  }
+  static bool invariant_range(const region2 &r, std::size_t begin,
+                              std::size_t end) {
+    return end - begin <= 1;
+  }
+  static std::size_t chi_size_range(const region2 &r, std::size_t begin,
+                                    std::size_t end) {
+    return end - begin;
+  }
+  static int compare_range(const region2 &r0, std::size_t begin0,
+                           std::size_t end0, const region2 &r1,
+                           std::size_t begin1, std::size_t end1) {
+    return (end0 - begin0 > end1 - begin1) - (end0 - begin0 < end1 - begin1);
+  }
+  static box<T, 0> bounding_box_range(const region2 &r, std::size_t begin,
+                                      std::size_t end) {
+    return box<T, 0>();
+  }
 
   // Invariant
-  bool invariant() const { return true; }
+  bool invariant() const { return m_count <= 1; }
+
+  // Shift and morphological operators (which are trivial here, also when
+  // applied to a buffer)
+  region2 &operator>>=(const point<T, 0> &p) { return *this; }
+  region2 &operator<<=(const point<T, 0> &p) { return *this; }
+  region2 operator>>(const point<T, 0> &p) const { return *this; }
+  region2 operator<<(const point<T, 0> &p) const { return *this; }
+  region2 grow(const point<T, 0> &dlo, const point<T, 0> &dhi) const {
+    return *this;
+  }
+  region2 grow(const T &n) const { return *this; }
+  region2 shrink(const point<T, 0> &dlo, const point<T, 0> &dhi) const {
+    return *this;
+  }
+  region2 shrink(const T &n) const { return *this; }
+  region2 coarsen(const point<T, 0> &f) const { return *this; }
+  region2 refine(const point<T, 0> &f) const { return *this; }
+  region2 downsample(const point<T, 0> &f) const { return *this; }
 
   // Predicates
-  bool empty() const { return !m_full; }
+  bool empty() const { return m_count == 0; }
   typedef typename point<T, 0>::prod_t prod_t;
-  prod_t size() const { return m_full; }
-  prod_t chi_size() const { return 1; }
+  prod_t size() const { return m_count; }
+  prod_t chi_size() const { return m_count; }
 
   // Conversion to boxes
   operator vector<box<T, 0>>() const {
@@ -858,16 +1357,16 @@ template <typename T> struct region2<T, 0> {
   box<T, 0> bounding_box() const { return box<T, 0>(); }
 
   region2 operator&(const region2 &other) const {
-    return region2(m_full & other.m_full);
+    return region2(!empty() & !other.empty());
   }
   region2 operator|(const region2 &other) const {
-    return region2(m_full | other.m_full);
+    return region2(!empty() | !other.empty());
   }
   region2 operator^(const region2 &other) const {
-    return region2(m_full ^ other.m_full);
+    return region2(!empty() ^ !other.empty());
   }
   region2 operator-(const region2 &other) const {
-    return region2(m_full && !other.m_full);
+    return region2(!empty() && other.empty());
   }
 
   region2 &operator^=(const region2 &other) { return *this = *this ^ other; }
@@ -875,12 +1374,19 @@ template <typename T> struct region2<T, 0> {
   region2 &operator|=(const region2 &other) { return *this = *this | other; }
   region2 &operator-=(const region2 &other) { return *this = *this - other; }
 
-  region2 intersection(const region2 &other) const { return *this & other; }
-  region2 setunion(const region2 &other) const { return *this | other; }
-  region2 symmetric_difference(const region2 &other) const {
+  region2 intersection(const region2 &other, bool parallel = false) const {
+    return *this & other;
+  }
+  region2 setunion(const region2 &other, bool parallel = false) const {
+    return *this | other;
+  }
+  region2 symmetric_difference(const region2 &other,
+                               bool parallel = false) const {
     return *this ^ other;
   }
-  region2 difference(const region2 &other) const { return *this - other; }
+  region2 difference(const region2 &other, bool parallel = false) const {
+    return *this - other;
+  }
 
   // Set comparison operators
   // bool contains(const point<T, 0> &p) const { return false; }
@@ -888,19 +1394,23 @@ template <typename T> struct region2<T, 0> {
 
   // Comparison operators
   bool operator<=(const region2 &other) const {
-    return !m_full || other.m_full;
+    return empty() || !other.empty();
   }
   bool operator>=(const region2 &other) const { return other <= *this; }
-  bool operator<(const region2 &other) const { return !m_full && other.m_full; }
+  bool operator<(const region2 &other) const {
+    return empty() && !other.empty();
+  }
   bool operator>(const region2 &other) const { return other < *this; }
   bool issubset(const region2 &other) const { return *this <= other; }
   bool issuperset(const region2 &other) const { return *this >= other; }
   bool is_strict_subset(const region2 &other) const { return *this < other; }
   bool is_strict_superset(const region2 &other) const { return *this > other; }
-  bool operator==(const region2 &other) const { return m_full == other.m_full; }
+  bool operator==(const region2 &other) const {
+    return m_count == other.m_count;
+  }
   bool operator!=(const region2 &other) const { return !(*this == other); }
 
-  bool less(const region2 &other) const { return m_full < other.m_full; }
+  bool less(const region2 &other) const { return m_count < other.m_count; }
 
   // Output
   ostream &output(ostream &os) const { return os << "{}"; }
@@ -910,10 +1420,12 @@ template <typename T> struct region2<T, 0> {
 };
 
 template <typename T, int D> struct region2 {
-  // TODO: D=0 subregions are never empty and thus don't need to be stored
   typedef region2<T, D - 1> subregion2_t;
-  typedef std::map<T, subregion2_t> subregions_t;
-  subregions_t subregions;
+  vector<T> positions;
+  // End of each subregion in the buffer (unused for D=1, where each
+  // subregion is a single full point)
+  vector<std::size_t> offsets;
+  subregion2_t subregions; // buffer
 
   region2() = default;
   region2(const region2 &) = default;
@@ -924,115 +1436,207 @@ template <typename T, int D> struct region2 {
   region2(const box<T, D> &b) {
     if (b.empty())
       return;
-    box<T, D - 1> subbox(b.lower().subpoint(D - 1), b.upper().subpoint(D - 1));
-    subregions[b.lower()[D - 1]] = subregion2_t(subbox);
-    subregions[b.upper()[D - 1]] = subregion2_t(subbox);
+    const subregion2_t subregion(
+        box<T, D - 1>(b.lower().subpoint(D - 1), b.upper().subpoint(D - 1)));
+    push_back(b.lower()[D - 1], subregion);
+    push_back(b.upper()[D - 1], subregion);
     assert(invariant());
   }
   region2(const point<T, D> &p) { *this = region2(box<T, D>(p)); }
-  template <typename U> region2(const region2<U, D> &r) {
-    for (const auto &pos_subregion : r.subregions) {
-      T pos(pos_subregion.first);
-      subregion2_t subregion(pos_subregion.second);
-      subregions[pos] = std::move(subregion);
-    }
+  template <typename U>
+  region2(const region2<U, D> &r)
+      : positions(r.positions.begin(), r.positions.end()), offsets(r.offsets),
+        subregions(r.subregions) {}
+
+  // Buffer access
+  std::size_t nentries() const { return positions.size(); }
+  void clear() {
+    positions.clear();
+    offsets.clear();
+    subregions.clear();
+  }
+  // Number of entries, in all dimensions, that the buffers can hold
+  std::size_t capacity() const {
+    return positions.capacity() + subregions.capacity();
+  }
+  // Beginning of subregion i in the buffer
+  std::size_t suboffset(std::size_t i) const {
+    return D == 1 ? i : i == 0 ? 0 : offsets[i - 1];
   }
 
 private:
+  void push_back(const T pos, const subregion2_t &subregion) {
+    subregion2_t::append_range(subregions, subregion, 0,
+                               subregion.nentries());
+    positions.push_back(pos);
+    if (D > 1)
+      offsets.push_back(subregions.nentries());
+  }
+
+  // Decode the subregion at position i, i.e. apply its changes to the
+  // current cross section
+  static void decode(subregion2_t &decoded_subregion, const region2 &r,
+                     std::size_t i, subregion2_t &tmp) {
+    tmp.clear();
+    subregion2_t::binary_range(
+        [](bool x, bool y) { return x != y; }, decoded_subregion, 0,
+        decoded_subregion.nentries(), r.subregions, r.suboffset(i),
+        r.suboffset(i + 1), tmp);
+    using std::swap;
+    swap(decoded_subregion, tmp);
+  }
+
   template <typename F> void traverse_subregions(const F &f) const {
-    subregion2_t decoded_subregion;
-    for (const auto &pos_subregion : subregions) {
-      const T pos = pos_subregion.first;
-      const auto &subregion = pos_subregion.second;
-      decoded_subregion ^= subregion;
-      f(pos, decoded_subregion);
+    subregion2_t decoded_subregion, tmp;
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      decode(decoded_subregion, *this, i, tmp);
+      f(positions[i], decoded_subregion);
     }
     assert(decoded_subregion.empty());
   }
 
+public:
+  static void append_range(region2 &res, const region2 &r, std::size_t begin,
+                           std::size_t end) {
+    const std::size_t subbegin = r.suboffset(begin), subend = r.suboffset(end);
+    const std::size_t base = res.subregions.nentries();
+    res.positions.insert(res.positions.end(), r.positions.begin() + begin,
+                         r.positions.begin() + end);
+    if (D > 1)
+      for (std::size_t i = begin; i < end; ++i)
+        res.offsets.push_back(base + r.offsets[i] - subbegin);
+    subregion2_t::append_range(res.subregions, r.subregions, subbegin, subend);
+  }
+
+  // Apply a set operation, given as boolean function on the membership of a
+  // point, and append the result to res
   template <typename F>
-  void traverse_subregions(const F &f, const region2 &other) const {
-    subregion2_t decoded_subregion0, decoded_subregion1;
-
-    typedef typename subregions_t::const_iterator subregions_iter_t;
-    subregions_iter_t iter0 = subregions.begin();
-    subregions_iter_t iter1 = other.subregions.begin();
-    const subregions_iter_t end0 = subregions.end();
-    const subregions_iter_t end1 = other.subregions.end();
-    while (iter0 != end0 || iter1 != end1) {
-      const T next_pos0 =
-          iter0 != end0 ? iter0->first : numeric_limits<T>::max();
-      const T next_pos1 =
-          iter1 != end1 ? iter1->first : numeric_limits<T>::max();
-      const T pos = min(next_pos0, next_pos1);
-      const bool active0 = next_pos0 == pos;
-      const bool active1 = next_pos1 == pos;
-      subregion2_t dummy;
-      const subregion2_t &subregion0 = active0 ? iter0->second : dummy;
-      const subregion2_t &subregion1 = active1 ? iter1->second : dummy;
-      if (active0)
-        decoded_subregion0 ^= subregion0;
-      if (active1)
-        decoded_subregion1 ^= subregion1;
-
-      f(pos, decoded_subregion0, decoded_subregion1);
-
+  static void binary_range(const F &op, const region2 &r0, std::size_t begin0,
+                           std::size_t end0, const region2 &r1,
+                           std::size_t begin1, std::size_t end1,
+                           region2 &res) {
+    // The decoded subregions are kept between calls to avoid reallocating
+    // their buffers, unless they have grown large
+    static thread_local subregion2_t decoded_subregion0, decoded_subregion1,
+        decoded_subregion, old_decoded_subregion, tmp;
+    decoded_subregion0.clear();
+    decoded_subregion1.clear();
+    old_decoded_subregion.clear();
+    std::size_t i0 = begin0, i1 = begin1;
+    while (i0 != end0 || i1 != end1) {
+      const bool active0 =
+          i0 != end0 && (i1 == end1 || r0.positions[i0] <= r1.positions[i1]);
+      const bool active1 =
+          i1 != end1 && (i0 == end0 || r1.positions[i1] <= r0.positions[i0]);
+      const T pos = active0 ? r0.positions[i0] : r1.positions[i1];
       if (active0)
-        ++iter0;
+        decode(decoded_subregion0, r0, i0++, tmp);
       if (active1)
-        ++iter1;
+        decode(decoded_subregion1, r1, i1++, tmp);
+
+      decoded_subregion.clear();
+      subregion2_t::binary_range(op, decoded_subregion0, 0,
+                                 decoded_subregion0.nentries(),
+                                 decoded_subregion1, 0,
+                                 decoded_subregion1.nentries(),
+                                 decoded_subregion);
+      // Store the change of the result, if any
+      const std::size_t old_nentries = res.subregions.nentries();
+      subregion2_t::binary_range([](bool x, bool y) { return x != y; },
+                                 decoded_subregion, 0,
+                                 decoded_subregion.nentries(),
+                                 old_decoded_subregion, 0,
+                                 old_decoded_subregion.nentries(),
+                                 res.subregions);
+      if (res.subregions.nentries() != old_nentries) {
+        res.positions.push_back(pos);
+        if (D > 1)
+          res.offsets.push_back(res.subregions.nentries());
+      }
+      using std::swap;
+      swap(old_decoded_subregion, decoded_subregion);
     }
     assert(decoded_subregion0.empty());
     assert(decoded_subregion1.empty());
-  }
-
-  template <typename F>
-  region2 binary_operator(const F &op, const region2 &other) const {
-    region2 res;
-    subregion2_t old_decoded_subregion;
-    traverse_subregions(
-        [&](const T pos, const subregion2_t &decoded_subregion0,
-            const subregion2_t &decoded_subregion1) {
-          auto decoded_subregion = op(decoded_subregion0, decoded_subregion1);
-          auto subregion = decoded_subregion ^ old_decoded_subregion;
-          if (!subregion.empty())
-            res.subregions[pos] = std::move(subregion);
-          using std::swap;
-          swap(old_decoded_subregion, decoded_subregion);
-        },
-        other);
     assert(old_decoded_subregion.empty());
-    assert(res.invariant());
-    return res;
-  }
-
-public:
-  // Invariant
-  bool invariant() const {
-    for (const auto &pos_subregion : subregions) {
-      const auto &subregion = pos_subregion.second;
-      // if (subregion.empty() || !subregion.invariant())
-      //   return false;
-      if (subregion.empty()) {
+    // Release the buffers after unusually large operations, so that threads
+    // (including pooled ones) do not hold on to their peak memory use
+    const std::size_t max_capacity = 1 << 16;
+    for (subregion2_t *buffer : {&decoded_subregion0, &decoded_subregion1,
+                                 &decoded_subregion, &old_decoded_subregion,
+                                 &tmp})
+      if (buffer->capacity() > max_capacity)
+        *buffer = subregion2_t();
+  }
+
+  static bool invariant_range(const region2 &r, std::size_t begin,
+                              std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      if (i > begin && !(r.positions[i - 1] < r.positions[i])) {
+        std::cerr << "!sorted D=" << D << "\n";
+        return false;
+      }
+      const std::size_t subbegin = r.suboffset(i), subend = r.suboffset(i + 1);
+      if (subbegin == subend) {
         std::cerr << "subregion.empty D=" << D << "\n";
         return false;
       }
-      if (!subregion.invariant()) {
+      if (!subregion2_t::invariant_range(r.subregions, subbegin, subend)) {
         std::cerr << "!subregion.invariant\n";
         return false;
       }
     }
-    // if (chi_size() % 2 != 0)
-    //   return false;
-    if (chi_size() % 2 != 0) {
+    if (chi_size_range(r, begin, end) % 2 != 0) {
       std::cerr << "chi_size\n";
       return false;
     }
     return true;
   }
 
+  static std::size_t chi_size_range(const region2 &r, std::size_t begin,
+                                    std::size_t end) {
+    return subregion2_t::chi_size_range(r.subregions, r.suboffset(begin),
+                                        r.suboffset(end));
+  }
+
+  static int compare_range(const region2 &r0, std::size_t begin0,
+                           std::size_t end0, const region2 &r1,
+                           std::size_t begin1, std::size_t end1) {
+    for (std::size_t i0 = begin0, i1 = begin1; i0 != end0 && i1 != end1;
+         ++i0, ++i1) {
+      if (r0.positions[i0] != r1.positions[i1])
+        return r0.positions[i0] < r1.positions[i1] ? -1 : 1;
+      if (int cmp = subregion2_t::compare_range(
+              r0.subregions, r0.suboffset(i0), r0.suboffset(i0 + 1),
+              r1.subregions, r1.suboffset(i1), r1.suboffset(i1 + 1)))
+        return cmp;
+    }
+    return (end0 - begin0 > end1 - begin1) - (end0 - begin0 < end1 - begin1);
+  }
+
+  static box<T, D> bounding_box_range(const region2 &r, std::size_t begin,
+                                      std::size_t end) {
+    if (begin == end)
+      return box<T, D>();
+    const auto minmax = std::minmax_element(r.positions.begin() + begin,
+                                            r.positions.begin() + end);
+    const auto subbox = subregion2_t::bounding_box_range(
+        r.subregions, r.suboffset(begin), r.suboffset(end));
+    return box<T, D>(subbox.lower().superpoint(D - 1, *minmax.first),
+                     subbox.upper().superpoint(D - 1, *minmax.second));
+  }
+
+  // Invariant
+  bool invariant() const {
+    if (D > 1 && offsets.size() != positions.size()) {
+      std::cerr << "offsets.size D=" << D << "\n";
+      return false;
+    }
+    return invariant_range(*this, 0, nentries());
+  }
+
   // Predicates
-  bool empty() const { return subregions.empty(); }
+  bool empty() const { return positions.empty(); }
 
   typedef typename point<T, D>::prod_t prod_t;
   prod_t size() const {
@@ -1050,138 +1654,416 @@ public:
     return total_size;
   }
 
-  prod_t chi_size() const {
-    prod_t sz = 0;
-    for (const auto &pos_subregion : subregions) {
-      const auto &subregion = pos_subregion.second;
-      sz += subregion.chi_size();
+  prod_t chi_size() const { return chi_size_range(*this, 0, nentries()); }
+
+  // Conversion from and to boxes
+
+private:
+  // Unite regions pairwise, so that the regions being combined have
+  // similar sizes
+  static region2 reduce(vector<region2> regions) {
+    if (regions.empty())
+      return region2();
+    while (regions.size() > 1) {
+      const std::size_t nregions = regions.size();
+      for (std::size_t i = 0; i < nregions / 2; ++i)
+        regions[i] = regions[2 * i] | regions[2 * i + 1];
+      if (nregions % 2 != 0)
+        regions[nregions / 2] = std::move(regions[nregions - 1]);
+      regions.resize((nregions + 1) / 2);
     }
-    return sz;
+    return std::move(regions[0]);
+  }
+  static region2 reduce(typename vector<box<T, D>>::const_iterator begin,
+                        typename vector<box<T, D>>::const_iterator end) {
+    vector<region2> regions;
+    regions.reserve(end - begin);
+    for (auto iter = begin; iter != end; ++iter)
+      if (!iter->empty())
+        regions.push_back(region2(*iter));
+    return reduce(std::move(regions));
   }
 
-  // Conversion from and to boxes
-  region2(const vector<box<T, D>> &boxes) {
-    // TODO: Use a tree reduction to make this more efficient
-    for (const auto &box : boxes)
-      *this |= region2(box);
+public:
+  // Boxes may overlap. When parallel is set, large box sets are split into
+  // one part per thread.
+  region2(const vector<box<T, D>> &boxes, bool parallel = false) {
+    const std::size_t nboxes = boxes.size();
+    const std::size_t min_boxes_per_thread = 1000;
+    const std::size_t max_threads =
+        max(1U, std::thread::hardware_concurrency());
+    const std::size_t nthreads =
+        !parallel ? 1 : min(max_threads, max(std::size_t(1),
+                                             nboxes / min_boxes_per_thread));
+    if (nthreads == 1) {
+      *this = reduce(boxes.begin(), boxes.end());
+      return;
+    }
+    vector<std::future<region2>> futures;
+    for (std::size_t n = 0; n < nthreads; ++n)
+      futures.push_back(std::async(std::launch::async, [&, n]() {
+        return reduce(boxes.begin() + n * nboxes / nthreads,
+                      boxes.begin() + (n + 1) * nboxes / nthreads);
+      }));
+    vector<region2> regions;
+    for (auto &future : futures)
+      regions.push_back(future.get());
+    *this = reduce(std::move(regions));
+  }
+
+  // Build a region from disjoint boxes, e.g. the normalized boxes of a
+  // region<T, D>, in a single sweep. Where the sweep crosses the lower or
+  // upper faces of boxes, the change of the cross section is the symmetric
+  // difference of the entering and the leaving boxes' cross sections.
+  static region2 from_disjoint(const vector<box<T, D>> &boxes) {
+    struct event_t {
+      T pos;
+      bool entering;
+      const box<T, D> *b;
+      bool operator<(const event_t &other) const { return pos < other.pos; }
+    };
+    vector<event_t> events;
+    events.reserve(2 * boxes.size());
+    for (const auto &b : boxes) {
+      if (b.empty())
+        continue;
+      events.push_back({b.lower()[D - 1], true, &b});
+      events.push_back({b.upper()[D - 1], false, &b});
+    }
+    std::sort(events.begin(), events.end());
+    region2 res;
+    vector<box<T, D - 1>> entering, leaving;
+    for (auto iter = events.begin(); iter != events.end();) {
+      const T pos = iter->pos;
+      entering.clear();
+      leaving.clear();
+      for (; iter != events.end() && iter->pos == pos; ++iter)
+        (iter->entering ? entering : leaving)
+            .push_back(box<T, D - 1>(iter->b->lower().subpoint(D - 1),
+                                     iter->b->upper().subpoint(D - 1)));
+      const auto subregion = subregion2_t::from_disjoint(entering) ^
+                             subregion2_t::from_disjoint(leaving);
+      if (!subregion.empty())
+        res.push_back(pos, subregion);
+    }
+    assert(res.invariant());
+    return res;
   }
 
+  // Convert to a canonical set of disjoint boxes. Boxes extend as far as
+  // possible in direction D-1.
   operator vector<box<T, D>>() const {
     vector<box<T, D>> res;
+    // The boxes of the current cross section, and where they began
     map<box<T, D - 1>, T> old_subboxes;
     traverse_subregions([&](const T pos, const subregion2_t &subregion) {
-      // Convert subregion to boxes
-      const vector<box<T, D - 1>> subboxes1(subregion);
-
-      auto iter0 = old_subboxes.begin();
-      auto iter1 = subboxes1.begin();
-      const auto end0 = old_subboxes.end();
-      const auto end1 = subboxes1.end();
-      assert(is_sorted(iter1, end1));
       map<box<T, D - 1>, T> subboxes;
-      while (iter0 != end0 || iter1 != end1) {
-        bool active0 = iter0 != end0;
-        bool active1 = iter1 != end1;
-        box<T, D - 1> dummy;
-        const box<T, D - 1> &subbox0 = active0 ? iter0->first : dummy;
-        const box<T, D - 1> &subbox1 = active1 ? *iter1 : dummy;
-        // When both subboxes are active, keep only the first (as determined by
-        // less<>)
-        std::equal_to<subregion2_t> eq;
-        std::less<subregion2_t> lt;
-        if (active0 && active1) {
-          active0 = !lt(subbox0, subbox1);
-          active1 = !lt(subbox1, subbox0);
-        }
-
-        if (active0 && active1 && eq(subbox0, subbox1)) {
-          assert(0);
-          // The current bbox continues unchanged -- keep it
-          subboxes[subbox1] = pos;
+      for (const auto &subbox : vector<box<T, D - 1>>(subregion)) {
+        const auto iter = old_subboxes.find(subbox);
+        if (iter == old_subboxes.end()) {
+          // There is a new box
+          subboxes[subbox] = pos;
         } else {
-          if (active0) {
-            const T old_pos = iter0->second;
-            // The current box changed; finalize it
-            res.push_back(box<T, D>(subbox0.lower().superpoint(D - 1, old_pos),
-                                    subbox0.upper().superpoint(D - 1, pos)));
-          }
-          if (active1) {
-            // There is a new box; add it
-            subboxes[subbox1] = pos;
-          }
+          // The box continues unchanged
+          subboxes[subbox] = iter->second;
+          old_subboxes.erase(iter);
         }
-
-        if (active0)
-          ++iter0;
-        if (active1)
-          ++iter1;
+      }
+      // The remaining boxes end here
+      for (const auto &subbox_pos : old_subboxes) {
+        const auto &subbox = subbox_pos.first;
+        res.push_back(
+            box<T, D>(subbox.lower().superpoint(D - 1, subbox_pos.second),
+                      subbox.upper().superpoint(D - 1, pos)));
       }
       using std::swap;
       swap(old_subboxes, subboxes);
     });
     assert(old_subboxes.empty());
-    assert(is_sorted(res.begin(), res.end()));
+    std::sort(res.begin(), res.end(), std::less<box<T, D>>());
     return res;
   }
 
   // Set operations
   box<T, D> bounding_box() const {
-    if (empty())
-      return box<T, D>();
-    point<T, D - 1> pmin(numeric_limits<T>::max()),
-        pmax(numeric_limits<T>::min());
-    for (const auto &subregion : subregions) {
-      auto subbox = subregion.bounding_box();
-      pmin = min(pmin, subbox.lower());
-      pmax = max(pmax, subbox.lower());
-    }
-    const T xmin = subregions.begin()->first;
-    const T xmax = subregions.rbegin()->first;
-    return box<T, D>(pmin.superpoint(D - 1, xmin),
-                     pmax.superpoint(D - 1, xmax));
+    return bounding_box_range(*this, 0, nentries());
   }
 
-  region2 operator^(const region2 &other) const {
-    // TODO: If other is much smaller than this, direct insertion may
-    // be faster
-    return binary_operator([](const subregion2_t &set0,
-                              const subregion2_t &set1) { return set0 ^ set1; },
-                           other);
+private:
+  template <typename F>
+  region2 binary_operator(const F &op, const region2 &other) const {
+    region2 res;
+    binary_range(op, *this, 0, nentries(), other, 0, other.nentries(), res);
+    assert(res.invariant());
+    return res;
   }
 
-  region2 operator&(const region2 &other) const {
-    return binary_operator([](const subregion2_t &set0,
-                              const subregion2_t &set1) { return set0 & set1; },
-                           other);
+  // The subregion at position i as separate region
+  subregion2_t subregion(std::size_t i) const {
+    subregion2_t res;
+    subregion2_t::append_range(res, subregions, suboffset(i),
+                               suboffset(i + 1));
+    return res;
   }
 
-  region2 operator|(const region2 &other) const {
-    return binary_operator([](const subregion2_t &set0,
-                              const subregion2_t &set1) { return set0 | set1; },
-                           other);
+  // The combined change of the subregions at positions [begin, end). The
+  // changes are combined pairwise, so that they remain small.
+  subregion2_t total_change(std::size_t begin, std::size_t end) const {
+    if (begin == end)
+      return subregion2_t();
+    if (end - begin == 1)
+      return subregion(begin);
+    const std::size_t middle = begin + (end - begin) / 2;
+    return total_change(begin, middle) ^ total_change(middle, end);
   }
 
-  region2 operator-(const region2 &other) const {
-    return binary_operator([](const subregion2_t &set0,
-                              const subregion2_t &set1) { return set0 - set1; },
-                           other);
+  // The part of r in the slab [lo, hi), where entries [begin, end) lie in the
+  // slab, and before and after are the cross sections at lo and hi
+  static region2 slab(const region2 &r, std::size_t begin, std::size_t end,
+                      const T lo, const subregion2_t &before, const T hi,
+                      const subregion2_t &after) {
+    region2 res;
+    std::size_t i = begin;
+    if (!before.empty()) {
+      if (i < end && r.positions[i] == lo) {
+        const auto subregion = before ^ r.subregion(i++);
+        if (!subregion.empty())
+          res.push_back(lo, subregion);
+      } else {
+        res.push_back(lo, before);
+      }
+    }
+    append_range(res, r, i, end);
+    if (!after.empty())
+      res.push_back(hi, after);
+    return res;
   }
 
-  region2 &operator^=(const region2 &other) { return *this = *this ^ other; }
-  region2 &operator&=(const region2 &other) { return *this = *this & other; }
-  region2 &operator|=(const region2 &other) { return *this = *this | other; }
-  region2 &operator-=(const region2 &other) { return *this = *this - other; }
+  // Apply a set operation concurrently to slabs in direction D-1. The slab
+  // boundaries are chosen so that the slabs contain similar numbers of
+  // positions. Small regions are handled serially.
+  template <typename F>
+  region2 parallel_binary_operator(const F &op, const region2 &other) const {
+    const std::size_t min_chi_size_per_thread = 10000;
+    const std::size_t max_threads =
+        max(1U, std::thread::hardware_concurrency());
+    const std::size_t chi_sizes = chi_size() + other.chi_size();
+    const std::size_t nthreads =
+        min(max_threads, chi_sizes / min_chi_size_per_thread);
+    if (nthreads <= 1)
+      return binary_operator(op, other);
+
+    vector<T> allpositions;
+    allpositions.reserve(nentries() + other.nentries());
+    std::merge(positions.begin(), positions.end(), other.positions.begin(),
+               other.positions.end(), std::back_inserter(allpositions));
+    // Slab n is [cuts[n], cuts[n+1]); the outermost cuts are not used
+    vector<T> cuts;
+    cuts.push_back(numeric_limits<T>::min());
+    for (std::size_t n = 1; n < nthreads; ++n) {
+      const T cut = allpositions[n * allpositions.size() / nthreads];
+      if (cut > cuts.back())
+        cuts.push_back(cut);
+    }
+    const std::size_t nslabs = cuts.size();
+    cuts.push_back(numeric_limits<T>::max());
+    const region2 *const rs[2] = {this, &other};
+    vector<std::size_t> begins[2];
+    for (int r = 0; r < 2; ++r) {
+      for (std::size_t n = 0; n < nslabs; ++n)
+        begins[r].push_back(std::lower_bound(rs[r]->positions.begin(),
+                                             rs[r]->positions.end(),
+                                             cuts[n]) -
+                            rs[r]->positions.begin());
+      begins[r].push_back(rs[r]->nentries());
+    }
 
-  region2 intersection(const region2 &other) const { return *this & other; }
-  region2 setunion(const region2 &other) const { return *this | other; }
-  region2 symmetric_difference(const region2 &other) const {
-    return *this ^ other;
-  }
-  region2 difference(const region2 &other) const { return *this - other; }
+    // Determine the cross sections at the slab boundaries: first the
+    // change within each slab, then their prefix sums
+    vector<subregion2_t> changes[2];
+    for (int r = 0; r < 2; ++r)
+      changes[r].resize(nslabs);
+    {
+      vector<std::future<void>> futures;
+      for (std::size_t n = 0; n < nslabs; ++n)
+        futures.push_back(std::async(std::launch::async, [&, n]() {
+          for (int r = 0; r < 2; ++r)
+            changes[r][n] =
+                rs[r]->total_change(begins[r][n], begins[r][n + 1]);
+        }));
+      for (auto &future : futures)
+        future.get();
+    }
+    vector<subregion2_t> crosssections[2];
+    for (int r = 0; r < 2; ++r) {
+      crosssections[r].resize(nslabs + 1);
+      for (std::size_t n = 0; n < nslabs; ++n)
+        crosssections[r][n + 1] = crosssections[r][n] ^ changes[r][n];
+      assert(crosssections[r][nslabs].empty());
+    }
 
-  // Set comparison operators
-  bool contains(const point<T, D> &p) const { return !isdisjoint(region2(p)); }
-  bool isdisjoint(const region2 &other) const {
+    vector<std::future<region2>> futures;
+    for (std::size_t n = 0; n < nslabs; ++n)
+      futures.push_back(std::async(std::launch::async, [&, n]() {
+        region2 slabs[2];
+        for (int r = 0; r < 2; ++r)
+          slabs[r] = slab(*rs[r], begins[r][n], begins[r][n + 1], cuts[n],
+                          crosssections[r][n], cuts[n + 1],
+                          crosssections[r][n + 1]);
+        return slabs[0].binary_operator(op, slabs[1]);
+      }));
+
+    // Stitch the slabs together, combining the changes at the boundaries
+    region2 res;
+    subregion2_t change;
+    for (std::size_t n = 0; n < nslabs; ++n) {
+      const region2 slabres = futures[n].get();
+      std::size_t begin = 0, end = slabres.nentries();
+      if (begin < end && n > 0 && slabres.positions[begin] == cuts[n])
+        change ^= slabres.subregion(begin++);
+      if (!change.empty())
+        res.push_back(cuts[n], change);
+      change.clear();
+      if (begin < end && n < nslabs - 1 &&
+          slabres.positions[end - 1] == cuts[n + 1])
+        change = slabres.subregion(--end);
+      append_range(res, slabres, begin, end);
+    }
+    assert(change.empty());
+    assert(res.invariant());
+    return res;
+  }
+
+public:
+  // When parallel is set, set operations between large regions are split
+  // into one slab per thread
+  region2 symmetric_difference(const region2 &other,
+                               bool parallel = false) const {
+    const auto op = [](bool x, bool y) { return x != y; };
+    return parallel ? parallel_binary_operator(op, other)
+                    : binary_operator(op, other);
+  }
+  region2 intersection(const region2 &other, bool parallel = false) const {
+    const auto op = [](bool x, bool y) { return x && y; };
+    return parallel ? parallel_binary_operator(op, other)
+                    : binary_operator(op, other);
+  }
+  region2 setunion(const region2 &other, bool parallel = false) const {
+    const auto op = [](bool x, bool y) { return x || y; };
+    return parallel ? parallel_binary_operator(op, other)
+                    : binary_operator(op, other);
+  }
+  region2 difference(const region2 &other, bool parallel = false) const {
+    const auto op = [](bool x, bool y) { return x && !y; };
+    return parallel ? parallel_binary_operator(op, other)
+                    : binary_operator(op, other);
+  }
+
+  region2 operator^(const region2 &other) const {
+    // TODO: If other is much smaller than this, direct insertion may
+    // be faster
+    return symmetric_difference(other);
+  }
+  region2 operator&(const region2 &other) const { return intersection(other); }
+  region2 operator|(const region2 &other) const { return setunion(other); }
+  region2 operator-(const region2 &other) const { return difference(other); }
+
+  region2 &operator^=(const region2 &other) { return *this = *this ^ other; }
+  region2 &operator&=(const region2 &other) { return *this = *this & other; }
+  region2 &operator|=(const region2 &other) { return *this = *this | other; }
+  region2 &operator-=(const region2 &other) { return *this = *this - other; }
+
+  // Shift operators. These act on all entries, so that they can be
+  // applied to the subregion buffer as a whole.
+  region2 &operator>>=(const point<T, D> &p) {
+    for (auto &pos : positions)
+      pos += p[D - 1];
+    subregions >>= p.subpoint(D - 1);
+    return *this;
+  }
+  region2 &operator<<=(const point<T, D> &p) { return *this >>= -p; }
+  region2 operator>>(const point<T, D> &p) const {
+    return region2(*this) >>= p;
+  }
+  region2 operator<<(const point<T, D> &p) const {
+    return region2(*this) <<= p;
+  }
+
+  // Morphological operators
+
+  // Grow by dlo points at the lower and by dhi points at the upper faces.
+  // In each direction, shifted copies are united, doubling the covered
+  // width each time.
+  region2 grow(const point<T, D> &dlo, const point<T, D> &dhi) const {
+    assert(all(dlo >= point<T, D>(0) && dhi >= point<T, D>(0)));
+    region2 res(*this);
+    for (int d = 0; d < D; ++d) {
+      const T width = dlo[d] + dhi[d] + 1;
+      point<T, D> shift(0);
+      for (T covered = 1; covered < width;) {
+        shift[d] = min(covered, width - covered);
+        res |= res >> shift;
+        covered += shift[d];
+      }
+      shift[d] = dlo[d];
+      res <<= shift;
+    }
+    return res;
+  }
+  region2 grow(const T &n) const {
+    return grow(point<T, D>(n), point<T, D>(n));
+  }
+  // Remove all points that are within dlo points of a lower or within dhi
+  // points of an upper face, i.e. keep the points whose neighbourhood lies
+  // entirely in the region
+  region2 shrink(const point<T, D> &dlo, const point<T, D> &dhi) const {
+    const region2 complement = region2(bounding_box().grow(1)) - *this;
+    return *this - complement.grow(dhi, dlo);
+  }
+  region2 shrink(const T &n) const {
+    return shrink(point<T, D>(n), point<T, D>(n));
+  }
+  // The points of the coarse grid covering this region, where each coarse
+  // point covers f fine points. A coarse point is selected if any of its
+  // fine points is, i.e. if its lower fine corner is within reach.
+  region2 coarsen(const point<T, D> &f) const {
+    assert(all(f > point<T, D>(0)));
+    return grow(f - point<T, D>(1), point<T, D>(0)).downsample(f);
+  }
+  // Each point becomes f fine points. This scales all positions, acting on
+  // all entries as the shift operators do.
+  region2 refine(const point<T, D> &f) const {
+    assert(all(f > point<T, D>(0)));
+    region2 res(*this);
+    for (auto &pos : res.positions)
+      pos *= f[D - 1];
+    res.subregions = res.subregions.refine(f.subpoint(D - 1));
+    return res;
+  }
+  // The points p for which p * f lies in this region. Sampling commutes
+  // with symmetric differences, so that the changes can be sampled
+  // individually; changes that end up at the same coarse position are
+  // combined.
+  region2 downsample(const point<T, D> &f) const {
+    region2 res;
+    const auto subf = f.subpoint(D - 1);
+    subregion2_t change;
+    for (std::size_t i = 0; i < nentries();) {
+      const T pos = detail::div_ceil(positions[i], f[D - 1]);
+      change.clear();
+      for (; i < nentries() &&
+             detail::div_ceil(positions[i], f[D - 1]) == pos;
+           ++i)
+        change ^= subregion(i).downsample(subf);
+      if (!change.empty())
+        res.push_back(pos, change);
+    }
+    return res;
+  }
+
+  // Set comparison operators
+  bool contains(const point<T, D> &p) const { return !isdisjoint(region2(p)); }
+  bool isdisjoint(const region2 &other) const {
     return (*this & other).empty();
   }
 
@@ -1199,21 +2081,18 @@ public:
   bool is_strict_subset(const region2 &other) const { return *this < other; }
   bool is_strict_superset(const region2 &other) const { return *this > other; }
   bool operator==(const region2 &other) const {
-    return subregions == other.subregions;
+    return positions == other.positions && offsets == other.offsets &&
+           subregions == other.subregions;
   }
   bool operator!=(const region2 &other) const { return !(*this == other); }
 
-  bool less(const region2 other) const {
-    std::less<subregions_t> lt;
-    return lt(subregions, other.subregions);
+  bool less(const region2 &other) const {
+    return compare_range(*this, 0, nentries(), other, 0, other.nentries()) <
+           0;
   }
 
   // Output
   ostream &output(ostream &os) const {
-    // os << "{";
-    // for (const auto &pos_subregion : subregions)
-    //   os << pos_subregion.first << ":" << pos_subregion.second << ",";
-    // os << "}";
     os << "{";
     const vector<box<T, D>> boxes(*this);
     for (std::size_t i = 0; i < boxes.size(); ++i) {
@@ -1230,6 +2109,484 @@ public:
 };
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Hash-consed regions
+////////////////////////////////////////////////////////////////////////////////
+
+namespace RegionCalculus {
+
+// An hregion is an immutable region built from hash-consed nodes. A node
+// of an hregion<T, D> holds the sorted positions in direction D-1 at which
+// the (D-1)-dimensional cross section changes, together with the cross
+// section starting at each position (the last cross section is empty).
+// Cross sections are themselves nodes of an hregion<T, D-1>.
+//
+// All nodes are unique: identical cross sections (e.g. all slabs of a box)
+// are shared, equality is a pointer comparison, and sizes are cached in
+// the nodes. Binary operations are memoized on their arguments, so that
+// repeated operations on the same subregions are cache hits. The tables
+// refer to nodes only weakly, so that nodes are freed when no hregion
+// refers to them any more.
+//
+// This is an alternative to region2 for large regular regions and for
+// repeated set operations; it is not used by the other region types.
+
+namespace detail {
+enum class hregion_op {
+  intersection,
+  setunion,
+  difference,
+  symmetric_difference
+};
+
+inline std::size_t hash_combine(std::size_t seed, std::size_t h) {
+  return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// The table of unique nodes and the memoized operations for one node type
+template <typename N> struct hnode_table {
+  typedef std::shared_ptr<const N> node_ptr;
+  // Entries of freed nodes are purged whenever a table has doubled in size
+  // since it was last purged, but not before it has this many entries
+  static const std::size_t min_purge_size = 1024;
+
+  struct memo_key {
+    hregion_op op;
+    const N *a, *b;
+    bool operator==(const memo_key &k) const {
+      return op == k.op && a == k.a && b == k.b;
+    }
+  };
+  struct memo_key_hash {
+    std::size_t operator()(const memo_key &k) const {
+      // The arguments may have been freed; hash only their addresses
+      const std::hash<const N *> h;
+      return hash_combine(hash_combine(std::size_t(k.op), h(k.a)), h(k.b));
+    }
+  };
+  // The arguments and the result are held weakly; when an argument has
+  // been freed, its address may have been reused, and the entry is stale
+  struct memo_entry {
+    std::weak_ptr<const N> a, b, result;
+  };
+
+  std::mutex mutex;
+  std::unordered_multimap<std::size_t, std::weak_ptr<const N>> nodes;
+  std::unordered_map<memo_key, memo_entry, memo_key_hash> memo;
+  std::size_t nodes_purge_size = min_purge_size;
+  std::size_t memo_purge_size = min_purge_size;
+
+  static hnode_table &get() {
+    static hnode_table table;
+    return table;
+  }
+
+  // Return the unique node equal to n
+  node_ptr intern(N &&n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto range = nodes.equal_range(n.hash);
+    for (auto it = range.first; it != range.second;) {
+      const auto node = it->second.lock();
+      if (!node) {
+        it = nodes.erase(it);
+        continue;
+      }
+      if (*node == n)
+        return node;
+      ++it;
+    }
+    // Allocate the node separately from its control block, so that weak
+    // references do not keep its memory alive
+    const auto node = node_ptr(new N(std::move(n)));
+    nodes.emplace(node->hash, node);
+    if (nodes.size() >= nodes_purge_size) {
+      for (auto it = nodes.begin(); it != nodes.end();) {
+        if (it->second.expired())
+          it = nodes.erase(it);
+        else
+          ++it;
+      }
+      nodes_purge_size =
+          std::max(std::size_t(min_purge_size), 2 * nodes.size());
+    }
+    return node;
+  }
+
+  node_ptr lookup(hregion_op op, const node_ptr &a, const node_ptr &b) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto it = memo.find(memo_key{op, a.get(), b.get()});
+    if (it == memo.end() || it->second.a.lock() != a ||
+        it->second.b.lock() != b)
+      return nullptr;
+    // This is null if the result has been freed in the mean time
+    return it->second.result.lock();
+  }
+
+  void insert(hregion_op op, const node_ptr &a, const node_ptr &b,
+              const node_ptr &result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    memo[memo_key{op, a.get(), b.get()}] = memo_entry{a, b, result};
+    if (memo.size() >= memo_purge_size) {
+      for (auto it = memo.begin(); it != memo.end();) {
+        if (it->second.a.expired() || it->second.b.expired() ||
+            it->second.result.expired())
+          it = memo.erase(it);
+        else
+          ++it;
+      }
+      memo_purge_size = std::max(std::size_t(min_purge_size), 2 * memo.size());
+    }
+  }
+
+  void clear_memo() {
+    std::lock_guard<std::mutex> lock(mutex);
+    memo.clear();
+  }
+};
+}
+
+template <typename T, int D> struct hregion;
+
+template <typename T> struct hregion<T, 0> {
+  template <typename U, int E> friend struct hregion;
+  typedef typename point<T, 0>::prod_t prod_t;
+
+  struct node {
+    bool full;
+    prod_t size;
+    std::size_t hash;
+    bool operator==(const node &n) const { return full == n.full; }
+  };
+  typedef std::shared_ptr<const node> node_ptr;
+  node_ptr root;
+
+  hregion() : root(empty_node()) {}
+  hregion(const box<T, 0> &b) : root(box_node(b)) {}
+  hregion(const vector<box<T, 0>> &bs) : root(empty_node()) {
+    for (const auto &b : bs)
+      root = apply(detail::hregion_op::setunion, root, box_node(b));
+  }
+  hregion(const region<T, 0> &r) : hregion(r.boxes) {}
+  operator vector<box<T, 0>>() const {
+    vector<box<T, 0>> bs;
+    append_boxes(bs, root);
+    return bs;
+  }
+
+  bool invariant() const { return bool(root); }
+  bool empty() const { return !root->full; }
+  prod_t size() const { return root->size; }
+  std::size_t hash() const { return root->hash; }
+
+  hregion intersection(const hregion &other) const {
+    return hregion(apply(detail::hregion_op::intersection, root, other.root));
+  }
+  hregion setunion(const hregion &other) const {
+    return hregion(apply(detail::hregion_op::setunion, root, other.root));
+  }
+  hregion difference(const hregion &other) const {
+    return hregion(apply(detail::hregion_op::difference, root, other.root));
+  }
+  hregion symmetric_difference(const hregion &other) const {
+    return hregion(
+        apply(detail::hregion_op::symmetric_difference, root, other.root));
+  }
+  hregion operator&(const hregion &other) const { return intersection(other); }
+  hregion operator|(const hregion &other) const { return setunion(other); }
+  hregion operator-(const hregion &other) const { return difference(other); }
+  hregion operator^(const hregion &other) const {
+    return symmetric_difference(other);
+  }
+
+  bool contains(const point<T, 0> &p) const { return root->full; }
+  bool operator<=(const hregion &other) const {
+    return (*this - other).empty();
+  }
+  bool operator==(const hregion &other) const { return root == other.root; }
+  bool operator!=(const hregion &other) const { return !(*this == other); }
+
+  ostream &output(ostream &os) const {
+    return os << region<T, 0>(vector<box<T, 0>>(*this));
+  }
+  friend ostream &operator<<(ostream &os, const hregion &r) {
+    return r.output(os);
+  }
+
+private:
+  explicit hregion(const node_ptr &root) : root(root) {}
+
+  static node_ptr make_node(bool full) {
+    return detail::hnode_table<node>::get().intern(
+        node{full, prod_t(full), std::size_t(full)});
+  }
+  static node_ptr empty_node() {
+    static const node_ptr n = make_node(false);
+    return n;
+  }
+  static node_ptr full_node() {
+    static const node_ptr n = make_node(true);
+    return n;
+  }
+  static node_ptr box_node(const box<T, 0> &b) {
+    return b.empty() ? empty_node() : full_node();
+  }
+  static node_ptr apply(detail::hregion_op op, const node_ptr &a,
+                        const node_ptr &b) {
+    bool full = false;
+    switch (op) {
+    case detail::hregion_op::intersection:
+      full = a->full && b->full;
+      break;
+    case detail::hregion_op::setunion:
+      full = a->full || b->full;
+      break;
+    case detail::hregion_op::difference:
+      full = a->full && !b->full;
+      break;
+    case detail::hregion_op::symmetric_difference:
+      full = a->full != b->full;
+      break;
+    default:
+      assert(0);
+    }
+    return full ? full_node() : empty_node();
+  }
+  static void append_boxes(vector<box<T, 0>> &bs, const node_ptr &n) {
+    if (n->full)
+      bs.push_back(box<T, 0>());
+  }
+  static bool contains(const node_ptr &n, const point<T, 0> &p) {
+    return n->full;
+  }
+};
+
+template <typename T, int D> struct hregion {
+  template <typename U, int E> friend struct hregion;
+  typedef typename point<T, D>::prod_t prod_t;
+  typedef hregion<T, D - 1> subregion_t;
+  typedef typename subregion_t::node_ptr section_ptr;
+
+  struct node {
+    vector<T> positions;
+    vector<section_ptr> sections;
+    prod_t size;
+    std::size_t hash;
+    // Sections are unique, so comparing pointers suffices
+    bool operator==(const node &n) const {
+      return positions == n.positions && sections == n.sections;
+    }
+  };
+  typedef std::shared_ptr<const node> node_ptr;
+  node_ptr root;
+
+  hregion() : root(empty_node()) {}
+  hregion(const box<T, D> &b) : root(box_node(b)) {}
+  // The boxes may overlap
+  hregion(const vector<box<T, D>> &bs) {
+    // Combine the boxes pairwise, which keeps the intermediate results
+    // small
+    vector<node_ptr> ns;
+    ns.reserve(bs.size());
+    for (const auto &b : bs)
+      ns.push_back(box_node(b));
+    while (ns.size() > 1) {
+      vector<node_ptr> merged;
+      merged.reserve((ns.size() + 1) / 2);
+      for (std::size_t i = 0; i + 1 < ns.size(); i += 2)
+        merged.push_back(apply(detail::hregion_op::setunion, ns[i], ns[i + 1]));
+      if (ns.size() % 2 != 0)
+        merged.push_back(ns.back());
+      ns = std::move(merged);
+    }
+    root = ns.empty() ? empty_node() : ns.front();
+  }
+  hregion(const region<T, D> &r) : hregion(r.boxes) {}
+  operator vector<box<T, D>>() const {
+    vector<box<T, D>> bs;
+    append_boxes(bs, root);
+    return bs;
+  }
+
+  // Invariant
+  bool invariant() const {
+    if (!root)
+      return false;
+    const auto &n = *root;
+    if (n.positions.size() != n.sections.size())
+      return false;
+    if (!n.sections.empty() &&
+        (n.sections.front() == subregion_t::empty_node() ||
+         n.sections.back() != subregion_t::empty_node()))
+      return false;
+    for (std::size_t i = 1; i < n.positions.size(); ++i)
+      if (!(n.positions[i - 1] < n.positions[i]) ||
+          n.sections[i - 1] == n.sections[i])
+        return false;
+    return true;
+  }
+
+  // Predicates
+  bool empty() const { return root->positions.empty(); }
+  prod_t size() const { return root->size; }
+  std::size_t hash() const { return root->hash; }
+
+  // Set operations
+  hregion intersection(const hregion &other) const {
+    return hregion(apply(detail::hregion_op::intersection, root, other.root));
+  }
+  hregion setunion(const hregion &other) const {
+    return hregion(apply(detail::hregion_op::setunion, root, other.root));
+  }
+  hregion difference(const hregion &other) const {
+    return hregion(apply(detail::hregion_op::difference, root, other.root));
+  }
+  hregion symmetric_difference(const hregion &other) const {
+    return hregion(
+        apply(detail::hregion_op::symmetric_difference, root, other.root));
+  }
+  hregion operator&(const hregion &other) const { return intersection(other); }
+  hregion operator|(const hregion &other) const { return setunion(other); }
+  hregion operator-(const hregion &other) const { return difference(other); }
+  hregion operator^(const hregion &other) const {
+    return symmetric_difference(other);
+  }
+  hregion &operator&=(const hregion &other) { return *this = *this & other; }
+  hregion &operator|=(const hregion &other) { return *this = *this | other; }
+  hregion &operator-=(const hregion &other) { return *this = *this - other; }
+  hregion &operator^=(const hregion &other) { return *this = *this ^ other; }
+
+  // Set comparison operators
+  bool contains(const point<T, D> &p) const { return contains(root, p); }
+  bool isdisjoint(const hregion &other) const {
+    return (*this & other).empty();
+  }
+
+  // Comparison operators
+  bool operator<=(const hregion &other) const {
+    return (*this - other).empty();
+  }
+  bool operator>=(const hregion &other) const { return other <= *this; }
+  bool operator<(const hregion &other) const {
+    return *this != other && *this <= other;
+  }
+  bool operator>(const hregion &other) const { return other < *this; }
+  bool operator==(const hregion &other) const { return root == other.root; }
+  bool operator!=(const hregion &other) const { return !(*this == other); }
+
+  // Forget all memoized operations (of this dimension)
+  static void clear_memo() { detail::hnode_table<node>::get().clear_memo(); }
+
+  // Output
+  ostream &output(ostream &os) const {
+    return os << region<T, D>(vector<box<T, D>>(*this));
+  }
+  friend ostream &operator<<(ostream &os, const hregion &r) {
+    return r.output(os);
+  }
+
+private:
+  explicit hregion(const node_ptr &root) : root(root) {}
+
+  static node_ptr make_node(vector<T> &&positions,
+                            vector<section_ptr> &&sections) {
+    node n{std::move(positions), std::move(sections), prod_t(0),
+           std::size_t(D)};
+    for (std::size_t i = 0; i < n.positions.size(); ++i) {
+      if (i + 1 < n.positions.size())
+        n.size += prod_t(n.positions[i + 1] - n.positions[i]) *
+                  n.sections[i]->size;
+      n.hash = detail::hash_combine(n.hash, std::hash<T>()(n.positions[i]));
+      n.hash = detail::hash_combine(n.hash, n.sections[i]->hash);
+    }
+    return detail::hnode_table<node>::get().intern(std::move(n));
+  }
+  static node_ptr empty_node() {
+    static const node_ptr n = make_node(vector<T>(), vector<section_ptr>());
+    return n;
+  }
+  static node_ptr box_node(const box<T, D> &b) {
+    if (b.empty())
+      return empty_node();
+    const section_ptr section = subregion_t::box_node(box<T, D - 1>(
+        b.lower().subpoint(D - 1), b.upper().subpoint(D - 1)));
+    return make_node(vector<T>{b.lower()[D - 1], b.upper()[D - 1]},
+                     vector<section_ptr>{section, subregion_t::empty_node()});
+  }
+
+  static node_ptr apply(detail::hregion_op op, const node_ptr &a,
+                        const node_ptr &b) {
+    typedef detail::hregion_op hregion_op;
+    // Trivial cases
+    if (a == b)
+      return op == hregion_op::intersection || op == hregion_op::setunion
+                 ? a
+                 : empty_node();
+    if (a->positions.empty())
+      return op == hregion_op::intersection || op == hregion_op::difference
+                 ? a
+                 : b;
+    if (b->positions.empty())
+      return op == hregion_op::intersection ? b : a;
+
+    auto &table = detail::hnode_table<node>::get();
+    if (const auto result = table.lookup(op, a, b))
+      return result;
+
+    // Sweep over both nodes, combining the current cross sections
+    vector<T> positions;
+    vector<section_ptr> sections;
+    section_ptr sa = subregion_t::empty_node(), sb = sa, last = sa;
+    std::size_t i = 0, j = 0;
+    const std::size_t na = a->positions.size(), nb = b->positions.size();
+    while (i < na || j < nb) {
+      T pos;
+      if (j >= nb || (i < na && a->positions[i] < b->positions[j])) {
+        pos = a->positions[i];
+        sa = a->sections[i++];
+      } else if (i >= na || b->positions[j] < a->positions[i]) {
+        pos = b->positions[j];
+        sb = b->sections[j++];
+      } else {
+        pos = a->positions[i];
+        sa = a->sections[i++];
+        sb = b->sections[j++];
+      }
+      const section_ptr section = subregion_t::apply(op, sa, sb);
+      if (section != last) {
+        positions.push_back(pos);
+        sections.push_back(section);
+        last = section;
+      }
+    }
+    const node_ptr result =
+        make_node(std::move(positions), std::move(sections));
+    table.insert(op, a, b, result);
+    return result;
+  }
+
+  static void append_boxes(vector<box<T, D>> &bs, const node_ptr &n) {
+    vector<box<T, D - 1>> subboxes;
+    for (std::size_t i = 0; i + 1 < n->positions.size(); ++i) {
+      subboxes.clear();
+      subregion_t::append_boxes(subboxes, n->sections[i]);
+      for (const auto &sb : subboxes)
+        bs.push_back(
+            box<T, D>(sb.lower().superpoint(D - 1, n->positions[i]),
+                      sb.upper().superpoint(D - 1, n->positions[i + 1])));
+    }
+  }
+
+  static bool contains(const node_ptr &n, const point<T, D> &p) {
+    const auto pos = std::upper_bound(n->positions.begin(),
+                                      n->positions.end(), p[D - 1]);
+    if (pos == n->positions.begin())
+      return false;
+    return subregion_t::contains(
+        n->sections[pos - n->positions.begin() - 1], p.subpoint(D - 1));
+  }
+};
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Dimension-independent wrappers
 ////////////////////////////////////////////////////////////////////////////////
@@ -2030,149 +3387,304 @@ unique_ptr<vregion<T>> vregion<T>::make(const vregion<U> &r) {
 
 // Dimension-independent classes (hiding the pointers)
 
+// Points and boxes of up to this rank are stored inline; they are trivially
+// copyable values that do not need to be allocated
+const int dmax_rank = 4;
+
 template <typename T> struct dpoint {
-  unique_ptr<vpoint<T>> val;
+private:
+  template <typename U> friend struct dpoint;
+  int m_rank;
+  array<T, dmax_rank> elt;
 
-  dpoint() = default;
+public:
+  dpoint() : m_rank(-1), elt() {}
 
-  dpoint(const dpoint &p) {
-    if (p.val)
-      val = p.val.copy();
+  template <int D> dpoint(const point<T, D> &p) : m_rank(D), elt() {
+    static_assert(D >= 0 && D <= dmax_rank, "");
+    for (int d = 0; d < D; ++d)
+      elt[d] = p.elt[d];
   }
-  dpoint(dpoint &&p) = default;
-  dpoint &operator=(const dpoint &p) {
-    if (p.val)
-      val = p.val->copy();
-    else
-      val = nullptr;
-    return *this;
+  dpoint(const vpoint<T> &p) : dpoint(vector<T>(p)) {}
+  dpoint(const unique_ptr<vpoint<T>> &val) : dpoint() {
+    if (val)
+      *this = dpoint(*val);
   }
-  dpoint &operator=(dpoint &&p) = default;
 
-  template <int D>
-  dpoint(const point<T, D> &p) : val(make_unique<wpoint<T, D>>(p)) {}
-  dpoint(const vpoint<T> &p) : val(p.copy()) {}
-  dpoint(const unique_ptr<vpoint<T>> &val) {
-    if (val)
-      this->val = val->copy();
+  explicit dpoint(int d) : dpoint(d, T(0)) {}
+  dpoint(int rank, const T &x) : m_rank(rank), elt() {
+    assert(m_rank >= 0 && m_rank <= dmax_rank);
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] = x;
+  }
+  template <size_t D> dpoint(const array<T, D> &p) : dpoint(point<T, D>(p)) {}
+  dpoint(const vector<T> &p) : m_rank(p.size()), elt() {
+    assert(m_rank <= dmax_rank);
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] = p[d];
+  }
+  operator vector<T>() const {
+    assert(valid());
+    return vector<T>(elt.begin(), elt.begin() + m_rank);
+  }
+  template <typename U> dpoint(const dpoint<U> &p) : m_rank(p.m_rank), elt() {
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] = T(p.elt[d]);
   }
-  dpoint(unique_ptr<vpoint<T>> &&val) : val(std::move(val)) {}
 
-  explicit dpoint(int d) : val(vpoint<T>::make(d)) {}
-  dpoint(int d, const T &x) : val(vpoint<T>::make(d, x)) {}
-  template <size_t D>
-  dpoint(const array<T, D> &p) : val(make_unique<wpoint<T, D>>(p)) {}
-  dpoint(const vector<T> &p) : val(vpoint<T>::make(p)) {}
-  operator vector<T>() const { return vector<T>(*val); }
-  template <typename U> dpoint(const dpoint<U> &p) {
-    if (p.val)
-      val = vpoint<T>::make(*p.val);
+  bool valid() const { return m_rank >= 0; }
+  void reset() { m_rank = -1; }
+  int rank() const {
+    assert(valid());
+    return m_rank;
   }
 
-  bool valid() const { return bool(val); }
-  void reset() { val.reset(); }
-  int rank() const { return val->rank(); }
+  // The statically typed point; D needs to be the rank
+  template <int D> point<T, D> get() const {
+    assert(rank() == D);
+    point<T, D> r;
+    for (int d = 0; d < D; ++d)
+      r.elt[d] = elt[d];
+    return r;
+  }
+  unique_ptr<vpoint<T>> to_vpoint() const {
+    assert(valid());
+    return vpoint<T>::make(vector<T>(*this));
+  }
+
+  // Call f with the statically typed point, resolving the rank once. F needs
+  // to accept point<T, D> for all ranks D.
+  template <typename F>
+  auto visit(const F &f) const
+      -> decltype(f(std::declval<const point<T, 0> &>())) {
+    switch (rank()) {
+    case 0:
+      return f(get<0>());
+    case 1:
+      return f(get<1>());
+    case 2:
+      return f(get<2>());
+    case 3:
+      return f(get<3>());
+    case 4:
+      return f(get<4>());
+    default:
+      assert(0);
+    }
+  }
 
   // Unary operators
-  dpoint operator+() const { return dpoint(+*val); }
-  dpoint operator-() const { return dpoint(-*val); }
-  dpoint operator~() const { return dpoint(~*val); }
-  dpoint<bool> operator!() const { return dpoint<bool>(!*val); }
+  dpoint operator+() const {
+    dpoint r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = +elt[d];
+    return r;
+  }
+  dpoint operator-() const {
+    dpoint r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = -elt[d];
+    return r;
+  }
+  dpoint operator~() const {
+    dpoint r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = ~elt[d];
+    return r;
+  }
+  dpoint<bool> operator!() const {
+    dpoint<bool> r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = !elt[d];
+    return r;
+  }
 
   // Assignment operators
   dpoint &operator+=(const dpoint &p) {
-    *val += *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] += p.elt[d];
     return *this;
   }
   dpoint &operator-=(const dpoint &p) {
-    *val -= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] -= p.elt[d];
     return *this;
   }
   dpoint &operator*=(const dpoint &p) {
-    *val *= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] *= p.elt[d];
     return *this;
   }
   dpoint &operator/=(const dpoint &p) {
-    *val /= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] /= p.elt[d];
     return *this;
   }
   dpoint &operator%=(const dpoint &p) {
-    *val %= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] %= p.elt[d];
     return *this;
   }
   dpoint &operator&=(const dpoint &p) {
-    *val &= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] &= p.elt[d];
     return *this;
   }
   dpoint &operator|=(const dpoint &p) {
-    *val |= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] |= p.elt[d];
     return *this;
   }
   dpoint &operator^=(const dpoint &p) {
-    *val ^= *p.val;
+    assert(p.rank() == rank());
+    for (int d = 0; d < m_rank; ++d)
+      elt[d] ^= p.elt[d];
     return *this;
   }
 
   // Binary operators
-  dpoint operator+(const dpoint &p) const { return dpoint(*val + *p.val); }
-  dpoint operator-(const dpoint &p) const { return dpoint(*val - *p.val); }
-  dpoint operator*(const dpoint &p) const { return dpoint(*val * *p.val); }
-  dpoint operator/(const dpoint &p) const { return dpoint(*val / *p.val); }
-  dpoint operator%(const dpoint &p) const { return dpoint(*val % *p.val); }
-  dpoint operator&(const dpoint &p) const { return dpoint(*val & *p.val); }
-  dpoint operator|(const dpoint &p) const { return dpoint(*val | *p.val); }
-  dpoint operator^(const dpoint &p) const { return dpoint(*val ^ *p.val); }
+  dpoint operator+(const dpoint &p) const { return dpoint(*this) += p; }
+  dpoint operator-(const dpoint &p) const { return dpoint(*this) -= p; }
+  dpoint operator*(const dpoint &p) const { return dpoint(*this) *= p; }
+  dpoint operator/(const dpoint &p) const { return dpoint(*this) /= p; }
+  dpoint operator%(const dpoint &p) const { return dpoint(*this) %= p; }
+  dpoint operator&(const dpoint &p) const { return dpoint(*this) &= p; }
+  dpoint operator|(const dpoint &p) const { return dpoint(*this) |= p; }
+  dpoint operator^(const dpoint &p) const { return dpoint(*this) ^= p; }
   dpoint<bool> operator&&(const dpoint &p) const {
-    return dpoint<bool>(*val && *p.val);
+    return dpoint<bool>(*this) &= dpoint<bool>(p);
   }
   dpoint<bool> operator||(const dpoint &p) const {
-    return dpoint<bool>(*val || *p.val);
+    return dpoint<bool>(*this) |= dpoint<bool>(p);
   }
 
   // Unary functions
-  dpoint abs() const { return dpoint(val->abs()); }
+  dpoint abs() const {
+    using std::abs;
+    dpoint r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = abs(elt[d]);
+    return r;
+  }
 
   // Binary functions
-  dpoint min(const dpoint &p) const { return dpoint(val->min(*p.val)); }
-  dpoint max(const dpoint &p) const { return dpoint(val->max(*p.val)); }
+  dpoint min(const dpoint &p) const {
+    using std::min;
+    assert(p.rank() == rank());
+    dpoint r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = min(elt[d], p.elt[d]);
+    return r;
+  }
+  dpoint max(const dpoint &p) const {
+    using std::max;
+    assert(p.rank() == rank());
+    dpoint r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = max(elt[d], p.elt[d]);
+    return r;
+  }
 
   // Comparison operators
   dpoint<bool> operator==(const dpoint &p) const {
-    return dpoint<bool>(*val == *p.val);
-  }
-  dpoint<bool> operator!=(const dpoint &p) const {
-    return dpoint<bool>(*val != *p.val);
+    assert(p.rank() == rank());
+    dpoint<bool> r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = elt[d] == p.elt[d];
+    return r;
   }
+  dpoint<bool> operator!=(const dpoint &p) const { return !(*this == p); }
   dpoint<bool> operator<(const dpoint &p) const {
-    return dpoint<bool>(*val < *p.val);
-  }
-  dpoint<bool> operator>(const dpoint &p) const {
-    return dpoint<bool>(*val > *p.val);
+    assert(p.rank() == rank());
+    dpoint<bool> r(rank());
+    for (int d = 0; d < m_rank; ++d)
+      r.elt[d] = elt[d] < p.elt[d];
+    return r;
   }
-  dpoint<bool> operator<=(const dpoint &p) const {
-    return dpoint<bool>(*val <= *p.val);
+  dpoint<bool> operator>(const dpoint &p) const { return p < *this; }
+  dpoint<bool> operator>=(const dpoint &p) const { return !(*this < p); }
+  dpoint<bool> operator<=(const dpoint &p) const { return !(*this > p); }
+
+  bool equal_to(const dpoint &p) const {
+    assert(p.rank() == rank());
+    std::equal_to<T> eq;
+    for (int d = 0; d < m_rank; ++d)
+      if (!eq(elt[d], p.elt[d]))
+        return false;
+    return true;
   }
-  dpoint<bool> operator>=(const dpoint &p) const {
-    return dpoint<bool>(*val >= *p.val);
+  bool less(const dpoint &p) const {
+    assert(p.rank() == rank());
+    std::less<T> lt;
+    for (int d = m_rank - 1; d >= 0; --d) {
+      if (lt(elt[d], p.elt[d]))
+        return true;
+      if (lt(p.elt[d], elt[d]))
+        return false;
+    }
+    return false;
   }
 
-  bool equal_to(const dpoint &p) const { return val->equal_to(*p.val); }
-  bool less(const dpoint &p) const { return val->less(*p.val); }
-
   // Reductions
-  bool all() const { return val->all(); }
-  bool any() const { return val->any(); }
-  T minval() const { return val->minval(); }
-  T maxval() const { return val->maxval(); }
-  T sum() const { return val->sum(); }
-  typedef typename vpoint<T>::prod_t prod_t;
-  prod_t prod() const { return val->prod(); }
+  bool all() const {
+    bool r = true;
+    for (int d = 0; d < rank(); ++d)
+      r = r && elt[d];
+    return r;
+  }
+  bool any() const {
+    bool r = false;
+    for (int d = 0; d < rank(); ++d)
+      r = r || elt[d];
+    return r;
+  }
+  T minval() const {
+    using std::min;
+    T r = std::numeric_limits<T>::max();
+    for (int d = 0; d < rank(); ++d)
+      r = min(r, elt[d]);
+    return r;
+  }
+  T maxval() const {
+    using std::max;
+    T r = std::numeric_limits<T>::min();
+    for (int d = 0; d < rank(); ++d)
+      r = max(r, elt[d]);
+    return r;
+  }
+  T sum() const {
+    T r = T(0);
+    for (int d = 0; d < rank(); ++d)
+      r += elt[d];
+    return r;
+  }
+  typedef typename point<T, 0>::prod_t prod_t;
+  prod_t prod() const {
+    prod_t r = prod_t(1);
+    for (int d = 0; d < rank(); ++d)
+      r *= elt[d];
+    return r;
+  }
 
   // Output
   ostream &output(ostream &os) const {
-    if (!val)
+    if (!valid())
       return os << "dpoint()";
-    return val->output(os);
+    os << "[";
+    for (int d = 0; d < m_rank; ++d) {
+      if (d > 0)
+        os << ",";
+      os << elt[d];
+    }
+    os << "]";
+    return os;
   }
   friend ostream &operator<<(ostream &os, const dpoint &p) {
     return p.output(os);
@@ -2219,81 +3731,176 @@ template <typename T> struct less<RegionCalculus::dpoint<T>> {
 
 namespace RegionCalculus {
 template <typename T> struct dbox {
-  unique_ptr<vbox<T>> val;
+private:
+  template <typename U> friend struct dbox;
+  dpoint<T> lo, hi;
 
+public:
   dbox() = default;
 
-  dbox(const dbox &b) {
-    if (b.val)
-      val = b.val->copy();
-  }
-  dbox(dbox &&b) = default;
-  dbox &operator=(const dbox &b) {
-    if (b.val)
-      val = b.val->copy();
-    else
-      val = nullptr;
-    return *this;
+  template <int D> dbox(const box<T, D> &b) : lo(b.lo), hi(b.hi) {}
+  dbox(const vbox<T> &b) {
+    switch (b.rank()) {
+    case 0:
+      *this = dbox(dynamic_cast<const wbox<T, 0> &>(b).val);
+      break;
+    case 1:
+      *this = dbox(dynamic_cast<const wbox<T, 1> &>(b).val);
+      break;
+    case 2:
+      *this = dbox(dynamic_cast<const wbox<T, 2> &>(b).val);
+      break;
+    case 3:
+      *this = dbox(dynamic_cast<const wbox<T, 3> &>(b).val);
+      break;
+    case 4:
+      *this = dbox(dynamic_cast<const wbox<T, 4> &>(b).val);
+      break;
+    default:
+      assert(0);
+    }
   }
-  dbox &operator=(dbox &&b) = default;
-
-  template <int D> dbox(const box<T, D> &b) : val(make_unique<wbox<T, D>>(b)) {}
-  dbox(const vbox<T> &b) : val(b.copy()) {}
   dbox(const unique_ptr<vbox<T>> &val) {
     if (val)
-      this->val = val->copy();
+      *this = dbox(*val);
   }
-  dbox(unique_ptr<vbox<T>> &&val) : val(std::move(val)) {}
 
-  explicit dbox(int d) : val(vbox<T>::make(d)) {}
-  dbox(const dpoint<T> &lo, const dpoint<T> &hi)
-      : val(vbox<T>::make(*lo.val, *hi.val)) {}
-  template <typename U> dbox(const dbox<U> &p) {
-    if (p.val)
-      val = vbox<T>::make(*p.val);
+  explicit dbox(int d) : lo(d), hi(d) {}
+  dbox(const dpoint<T> &lo, const dpoint<T> &hi) : lo(lo), hi(hi) {
+    assert(lo.rank() == hi.rank());
   }
+  template <typename U> dbox(const dbox<U> &b) : lo(b.lo), hi(b.hi) {}
 
-  bool valid() const { return bool(val); }
-  void reset() { val.reset(); }
-  int rank() const { return val->rank(); }
+  bool valid() const { return lo.valid(); }
+  void reset() {
+    lo.reset();
+    hi.reset();
+  }
+  int rank() const { return lo.rank(); }
+
+  // The statically typed box; D needs to be the rank
+  template <int D> box<T, D> get() const {
+    return box<T, D>(lo.template get<D>(), hi.template get<D>());
+  }
+  unique_ptr<vbox<T>> to_vbox() const {
+    return vbox<T>::make(*lo.to_vpoint(), *hi.to_vpoint());
+  }
+
+  // Call f with the statically typed box, resolving the rank once. F needs
+  // to accept box<T, D> for all ranks D.
+  template <typename F>
+  auto visit(const F &f) const
+      -> decltype(f(std::declval<const box<T, 0> &>())) {
+    switch (rank()) {
+    case 0:
+      return f(get<0>());
+    case 1:
+      return f(get<1>());
+    case 2:
+      return f(get<2>());
+    case 3:
+      return f(get<3>());
+    case 4:
+      return f(get<4>());
+    default:
+      assert(0);
+    }
+  }
 
   // Predicates
-  bool empty() const { return val->empty(); }
-  dpoint<T> lower() const { return dpoint<T>(val->lower()); }
-  dpoint<T> upper() const { return dpoint<T>(val->upper()); }
-  dpoint<T> shape() const { return dpoint<T>(val->shape()); }
-  typedef typename vbox<T>::prod_t prod_t;
-  prod_t size() const { return val->size(); }
+  bool empty() const { return any(hi <= lo); }
+  dpoint<T> lower() const { return empty() ? dpoint<T>(rank()) : lo; }
+  dpoint<T> upper() const { return empty() ? dpoint<T>(rank()) : hi; }
+  dpoint<T> shape() const { return max(hi - lo, dpoint<T>(rank())); }
+  typedef typename dpoint<T>::prod_t prod_t;
+  prod_t size() const { return prod(shape()); }
 
   // Shift and scale operators
   dbox &operator>>=(const dpoint<T> &p) {
-    *val >>= *p.val;
+    lo += p;
+    hi += p;
     return *this;
   }
   dbox &operator<<=(const dpoint<T> &p) {
-    *val <<= *p.val;
+    lo -= p;
+    hi -= p;
     return *this;
   }
   dbox &operator*=(const dpoint<T> &p) {
-    *val *= *p.val;
+    lo *= p;
+    hi *= p;
     return *this;
   }
-  dbox operator>>(const dpoint<T> &p) const { return dbox(*val >> *p.val); }
-  dbox operator<<(const dpoint<T> &p) const { return dbox(*val << *p.val); }
-  dbox operator*(const dpoint<T> &p) const { return dbox(*val * *p.val); }
+  dbox operator>>(const dpoint<T> &p) const { return dbox(*this) >>= p; }
+  dbox operator<<(const dpoint<T> &p) const { return dbox(*this) <<= p; }
+  dbox operator*(const dpoint<T> &p) const { return dbox(*this) *= p; }
+
+  // Morphological operators
+  dbox grow(const dpoint<T> &dlo, const dpoint<T> &dhi) const {
+    if (empty())
+      return *this;
+    return dbox(lo - dlo, hi + dhi);
+  }
+  dbox grow(const T &n) const {
+    return grow(dpoint<T>(rank(), n), dpoint<T>(rank(), n));
+  }
+  dbox shrink(const dpoint<T> &dlo, const dpoint<T> &dhi) const {
+    return grow(-dlo, -dhi);
+  }
+  dbox shrink(const T &n) const { return grow(-n); }
+  dbox coarsen(const dpoint<T> &f) const { return visit(coarsen_by{f}); }
+  dbox refine(const dpoint<T> &f) const {
+    assert(all(f > dpoint<T>(rank())));
+    return *this * f;
+  }
 
+private:
+  struct coarsen_by {
+    const dpoint<T> &f;
+    template <int D> dbox operator()(const box<T, D> &b) const {
+      return b.coarsen(f.template get<D>());
+    }
+  };
+
+public:
   // Comparison operators
-  bool operator==(const dbox &b) const { return *val == *b.val; }
-  bool operator!=(const dbox &b) const { return *val != *b.val; }
-  bool less(const dbox &b) const { return val->less(*b.val); }
+  bool operator==(const dbox &b) const {
+    if (empty() && b.empty())
+      return true;
+    if (empty() || b.empty())
+      return false;
+    return lo.equal_to(b.lo) && hi.equal_to(b.hi);
+  }
+  bool operator!=(const dbox &b) const { return !(*this == b); }
+  bool less(const dbox &b) const {
+    if (b.empty())
+      return false;
+    if (empty())
+      return true;
+    if (lo.less(b.lo))
+      return true;
+    if (b.lo.less(lo))
+      return false;
+    return hi.less(b.hi);
+  }
 
   // Set comparison operators
-  bool contains(const dpoint<T> &p) const { return val->contains(*p.val); }
-  bool isdisjoint(const dbox &b) const { return val->isdisjoint(*b.val); }
-  bool operator<=(const dbox &b) const { return *val <= *b.val; }
-  bool operator>=(const dbox &b) const { return *val >= *b.val; }
-  bool operator<(const dbox &b) const { return *val < *b.val; }
-  bool operator>(const dbox &b) const { return *val > *b.val; }
+  bool contains(const dpoint<T> &p) const {
+    if (empty())
+      return false;
+    return all(p >= lo && p < hi);
+  }
+  bool isdisjoint(const dbox &b) const { return (*this & b).empty(); }
+  bool operator<=(const dbox &b) const {
+    if (empty())
+      return true;
+    if (b.empty())
+      return false;
+    return all(lo >= b.lo && hi <= b.hi);
+  }
+  bool operator>=(const dbox &b) const { return b <= *this; }
+  bool operator<(const dbox &b) const { return *this <= b && *this != b; }
+  bool operator>(const dbox &b) const { return b < *this; }
   bool issubset(const dbox &b) const { return *this <= b; }
   bool issuperset(const dbox &b) const { return *this >= b; }
   bool is_strict_subset(const dbox &b) const { return *this < b; }
@@ -2301,22 +3908,22 @@ template <typename T> struct dbox {
 
   // Set operations
   dbox bounding_box(const dbox &b) const {
-    return dbox(val->bounding_box(*b.val));
+    if (empty())
+      return b;
+    if (b.empty())
+      return *this;
+    return dbox(min(lo, b.lo), max(hi, b.hi));
+  }
+  dbox operator&(const dbox &b) const {
+    return dbox(max(lo, b.lo), min(hi, b.hi));
   }
-  dbox operator&(const dbox &b) const { return dbox(*val & *b.val); }
-  // dbox operator-(const dbox &b) const { return dbox(*val - *b.val); }
-  // dbox operator|(const dbox &b) const { return dbox(*val | *b.val); }
-  // dbox operator^(const dbox &b) const { return dbox(*val ^ *b.val); }
   dbox intersection(const dbox &b) const { return *this & b; }
-  // dbox difference(const dbox &b) const { return *this - b; }
-  // dbox setunion(const dbox &b) const { return *this | b; }
-  // dbox symmetric_difference(const dbox &b) const { return *this ^ b; }
 
   // Output
   ostream &output(ostream &os) const {
-    if (!val)
+    if (!valid())
       return os << "dbox()";
-    return val->output(os);
+    return os << "(" << lo << ":" << hi << ")";
   }
   friend ostream &operator<<(ostream &os, const dbox &b) {
     return b.output(os);
@@ -2363,12 +3970,29 @@ template <typename T> struct dregion {
   // dregion(unique_ptr<vregion<T>> &&val) : val(std::move(val)) {}
 
   explicit dregion(int d) : val(vregion<T>::make(d)) {}
-  dregion(const dbox<T> &b) : val(vregion<T>::make(*b.val)) {}
+  dregion(const dbox<T> &b) : val(b.visit(from_box())) {}
   dregion(const vector<dbox<T>> &bs) {
-    vector<unique_ptr<vbox<T>>> rs;
-    for (const auto &b : bs)
-      rs.push_back(b.val->copy());
-    val = vregion<T>::make(rs);
+    if (bs.empty())
+      return;
+    switch (bs[0].rank()) {
+    case 0:
+      val = make<0>(bs);
+      break;
+    case 1:
+      val = make<1>(bs);
+      break;
+    case 2:
+      val = make<2>(bs);
+      break;
+    case 3:
+      val = make<3>(bs);
+      break;
+    case 4:
+      val = make<4>(bs);
+      break;
+    default:
+      assert(0);
+    }
   }
   // dregion(vector<dbox<T>> &&bs) {
   //   vector<unique_ptr<vbox<T>>> rs;
@@ -2392,6 +4016,51 @@ template <typename T> struct dregion {
   void reset() { val.reset(); }
   int rank() const { return val->rank(); }
 
+  // Call f with the statically typed region, resolving the rank once. F
+  // needs to accept region<T, D> for all ranks D. This allows running inner
+  // loops on region<T, D> without virtual calls or heap allocations, e.g.
+  //   struct count_boxes {
+  //     template <int D> size_t operator()(const region<T, D> &r) const {
+  //       return r.boxes.size();
+  //     }
+  //   };
+  //   size_t nboxes = r.visit(count_boxes());
+  template <typename F>
+  auto visit(const F &f) const
+      -> decltype(f(std::declval<const region<T, 0> &>())) {
+    switch (rank()) {
+    case 0:
+      return f(dynamic_cast<const wregion<T, 0> &>(*val).val);
+    case 1:
+      return f(dynamic_cast<const wregion<T, 1> &>(*val).val);
+    case 2:
+      return f(dynamic_cast<const wregion<T, 2> &>(*val).val);
+    case 3:
+      return f(dynamic_cast<const wregion<T, 3> &>(*val).val);
+    case 4:
+      return f(dynamic_cast<const wregion<T, 4> &>(*val).val);
+    default:
+      assert(0);
+    }
+  }
+  template <typename F>
+  auto visit(const F &f) -> decltype(f(std::declval<region<T, 0> &>())) {
+    switch (rank()) {
+    case 0:
+      return f(dynamic_cast<wregion<T, 0> &>(*val).val);
+    case 1:
+      return f(dynamic_cast<wregion<T, 1> &>(*val).val);
+    case 2:
+      return f(dynamic_cast<wregion<T, 2> &>(*val).val);
+    case 3:
+      return f(dynamic_cast<wregion<T, 3> &>(*val).val);
+    case 4:
+      return f(dynamic_cast<wregion<T, 4> &>(*val).val);
+    default:
+      assert(0);
+    }
+  }
+
   // Predicates
   bool invariant() const { return val->invariant(); }
   bool empty() const { return val->empty(); }
@@ -2400,13 +4069,21 @@ template <typename T> struct dregion {
 
   // Set operations
   dbox<T> bounding_box() const { return dbox<T>(val->bounding_box()); }
-  dregion operator&(const dbox<T> &b) const { return dregion(*val & *b.val); }
+  dregion operator&(const dbox<T> &b) const {
+    return visit(setop_box{setop_box::intersect, b});
+  }
   dregion operator&(const dregion &r) const { return dregion(*val & *r.val); }
-  dregion operator-(const dbox<T> &b) const { return dregion(*val - *b.val); }
+  dregion operator-(const dbox<T> &b) const {
+    return visit(setop_box{setop_box::subtract, b});
+  }
   dregion operator-(const dregion &r) const { return dregion(*val - *r.val); }
-  dregion operator|(const dbox<T> &b) const { return dregion(*val | *b.val); }
+  dregion operator|(const dbox<T> &b) const {
+    return visit(setop_box{setop_box::unite, b});
+  }
   dregion operator|(const dregion &r) const { return dregion(*val | *r.val); }
-  dregion operator^(const dbox<T> &b) const { return dregion(*val ^ *b.val); }
+  dregion operator^(const dbox<T> &b) const {
+    return visit(setop_box{setop_box::symdiff, b});
+  }
   dregion operator^(const dregion &r) const { return dregion(*val ^ *r.val); }
   dregion intersection(const dbox<T> &b) const { return *this & b; }
   dregion intersection(const dregion &r) const { return *this & r; }
@@ -2418,8 +4095,12 @@ template <typename T> struct dregion {
   dregion symmetric_difference(const dregion &r) const { return *this ^ r; }
 
   // Set comparison operators
-  bool contains(const dpoint<T> &p) const { return val->contains(*p.val); }
-  bool isdisjoint(const dbox<T> &b) const { return val->isdisjoint(*b.val); }
+  bool contains(const dpoint<T> &p) const {
+    return visit(contains_point{p});
+  }
+  bool isdisjoint(const dbox<T> &b) const {
+    return visit(isdisjoint_box{b});
+  }
   bool isdisjoint(const dregion &r) const { return val->isdisjoint(*r.val); }
 
   // Comparison operators
@@ -2436,6 +4117,167 @@ template <typename T> struct dregion {
 
   bool less(const dregion &r) const { return val->less(*r.val); }
 
+  // Batched operations, resolving the rank once for all arguments
+  vector<bool> contains(const vector<dpoint<T>> &ps) const {
+    return visit(contains_all{ps});
+  }
+  vector<bool> isdisjoint(const vector<dbox<T>> &bs) const {
+    return visit(isdisjoint_all{bs});
+  }
+
+  // Split into npieces disjoint pieces of balanced size along a
+  // space-filling curve
+  vector<dregion> partition(int npieces, sfc_t curve = sfc_t::hilbert) const {
+    return visit(partition_into{npieces, curve});
+  }
+
+  // Shift and morphological operators
+  dregion operator>>(const dpoint<T> &p) const {
+    return visit(transform{transform::shift, p, p});
+  }
+  dregion operator<<(const dpoint<T> &p) const { return *this >> -p; }
+  dregion grow(const dpoint<T> &dlo, const dpoint<T> &dhi) const {
+    return visit(transform{transform::grow, dlo, dhi});
+  }
+  dregion grow(const T &n) const {
+    return grow(dpoint<T>(rank(), n), dpoint<T>(rank(), n));
+  }
+  dregion shrink(const dpoint<T> &dlo, const dpoint<T> &dhi) const {
+    return visit(transform{transform::shrink, dlo, dhi});
+  }
+  dregion shrink(const T &n) const {
+    return shrink(dpoint<T>(rank(), n), dpoint<T>(rank(), n));
+  }
+  dregion coarsen(const dpoint<T> &f) const {
+    return visit(transform{transform::coarsen, f, f});
+  }
+  dregion refine(const dpoint<T> &f) const {
+    return visit(transform{transform::refine, f, f});
+  }
+
+  // Split along the boundaries of the chunk grid with the given origin and
+  // chunk shape; see chunk_decomposition
+  vector<std::pair<dpoint<T>, vector<dbox<T>>>>
+  chunks(const dpoint<T> &origin, const dpoint<T> &shape) const {
+    return visit(chunks_of{origin, shape});
+  }
+
+private:
+  template <int D>
+  static unique_ptr<vregion<T>> make(const vector<dbox<T>> &bs) {
+    vector<box<T, D>> rs;
+    rs.reserve(bs.size());
+    for (const auto &b : bs)
+      rs.push_back(b.template get<D>());
+    return make_unique<wregion<T, D>>(region<T, D>(std::move(rs)));
+  }
+  struct from_box {
+    template <int D>
+    unique_ptr<vregion<T>> operator()(const box<T, D> &b) const {
+      return make_unique<wregion<T, D>>(region<T, D>(b));
+    }
+  };
+  struct setop_box {
+    enum op_t { intersect, subtract, unite, symdiff } op;
+    const dbox<T> &b;
+    template <int D> dregion operator()(const region<T, D> &r) const {
+      const auto a = b.template get<D>();
+      switch (op) {
+      case intersect:
+        return dregion(r & a);
+      case subtract:
+        return dregion(r - a);
+      case unite:
+        return dregion(r | a);
+      case symdiff:
+        return dregion(r ^ a);
+      default:
+        assert(0);
+      }
+    }
+  };
+  struct contains_point {
+    const dpoint<T> &p;
+    template <int D> bool operator()(const region<T, D> &r) const {
+      return r.contains(p.template get<D>());
+    }
+  };
+  struct isdisjoint_box {
+    const dbox<T> &b;
+    template <int D> bool operator()(const region<T, D> &r) const {
+      return r.isdisjoint(b.template get<D>());
+    }
+  };
+  struct contains_all {
+    const vector<dpoint<T>> &ps;
+    template <int D> vector<bool> operator()(const region<T, D> &r) const {
+      vector<bool> res;
+      res.reserve(ps.size());
+      for (const auto &p : ps)
+        res.push_back(r.contains(p.template get<D>()));
+      return res;
+    }
+  };
+  struct isdisjoint_all {
+    const vector<dbox<T>> &bs;
+    template <int D> vector<bool> operator()(const region<T, D> &r) const {
+      vector<bool> res;
+      res.reserve(bs.size());
+      for (const auto &b : bs)
+        res.push_back(r.isdisjoint(b.template get<D>()));
+      return res;
+    }
+  };
+  struct transform {
+    enum op_t { shift, grow, shrink, coarsen, refine } op;
+    const dpoint<T> &p, &q;
+    template <int D> dregion operator()(const region<T, D> &r) const {
+      const auto a = p.template get<D>(), b = q.template get<D>();
+      switch (op) {
+      case shift:
+        return dregion(r >> a);
+      case grow:
+        return dregion(r.grow(a, b));
+      case shrink:
+        return dregion(r.shrink(a, b));
+      case coarsen:
+        return dregion(r.coarsen(a));
+      case refine:
+        return dregion(r.refine(a));
+      default:
+        assert(0);
+      }
+    }
+  };
+  struct chunks_of {
+    const dpoint<T> &origin, &shape;
+    template <int D>
+    vector<std::pair<dpoint<T>, vector<dbox<T>>>>
+    operator()(const region<T, D> &r) const {
+      vector<std::pair<dpoint<T>, vector<dbox<T>>>> res;
+      for (const auto &chunk : chunk_decomposition(
+               r, chunk_grid<T, D>(origin.template get<D>(),
+                                   shape.template get<D>())))
+        res.emplace_back(dpoint<T>(chunk.first),
+                         vector<dbox<T>>(chunk.second.begin(),
+                                         chunk.second.end()));
+      return res;
+    }
+  };
+  struct partition_into {
+    int npieces;
+    sfc_t curve;
+    template <int D>
+    vector<dregion> operator()(const region<T, D> &r) const {
+      vector<dregion> res;
+      res.reserve(npieces);
+      for (const auto &piece : RegionCalculus::partition(r, npieces, curve))
+        res.push_back(dregion(piece));
+      return res;
+    }
+  };
+
+public:
   // Output
   ostream &output(ostream &os) const {
     if (!val)
@@ -2457,4 +4299,40 @@ template <typename T> struct less<RegionCalculus::dregion<T>> {
 };
 }
 
+namespace RegionCalculus {
+namespace detail {
+template <typename T, int D>
+vector<std::size_t> sfc_order(const vector<dbox<T>> &bs, sfc_t curve) {
+  vector<box<T, D>> rs;
+  rs.reserve(bs.size());
+  for (const auto &b : bs)
+    rs.push_back(b.template get<D>());
+  return RegionCalculus::sfc_order(rs, curve);
+}
+}
+
+// The permutation that sorts the boxes (which need to have the same rank)
+// along a space-filling curve
+template <typename T>
+vector<std::size_t> sfc_order(const vector<dbox<T>> &bs,
+                              sfc_t curve = sfc_t::hilbert) {
+  if (bs.empty())
+    return vector<std::size_t>();
+  switch (bs[0].rank()) {
+  case 0:
+    return detail::sfc_order<T, 0>(bs, curve);
+  case 1:
+    return detail::sfc_order<T, 1>(bs, curve);
+  case 2:
+    return detail::sfc_order<T, 2>(bs, curve);
+  case 3:
+    return detail::sfc_order<T, 3>(bs, curve);
+  case 4:
+    return detail::sfc_order<T, 4>(bs, curve);
+  default:
+    assert(0);
+  }
+}
+}
+
 #endif // REGIONCALCULUS_HPP
@@ -0,0 +1,174 @@
+#include "Selection.hpp"
+
+#include "Configuration.hpp"
+#include "DiscreteField.hpp"
+#include "DiscreteFieldBlock.hpp"
+#include "DiscreteFieldBlockComponent.hpp"
+#include "Discretization.hpp"
+#include "Field.hpp"
+#include "Parameter.hpp"
+#include "TensorComponent.hpp"
+
+#include <fnmatch.h>
+
+#include <map>
+#include <set>
+
+namespace SimulationIO {
+
+using std::map;
+using std::set;
+
+namespace {
+bool matches(const vector<string> &patterns, const string &name) {
+  for (const auto &pattern : patterns)
+    if (fnmatch(pattern.c_str(), name.c_str(), 0) != 0)
+      return false;
+  return true;
+}
+
+// Find the entries of a map whose names match all patterns. Since maps are
+// ordered, only the names beginning with the literal prefix of the first
+// pattern need to be examined.
+template <typename T>
+vector<T> findMatching(const map<string, T> &m,
+                       const vector<string> &patterns) {
+  auto begin = m.begin(), end = m.end();
+  if (!patterns.empty()) {
+    const auto &pattern = patterns.front();
+    const auto prefix = pattern.substr(0, pattern.find_first_of("*?[\\"));
+    begin = end = m.lower_bound(prefix);
+    while (end != m.end() &&
+           end->first.compare(0, prefix.size(), prefix) == 0)
+      ++end;
+  }
+  vector<T> result;
+  for (auto it = begin; it != end; ++it)
+    if (matches(patterns, it->first))
+      result.push_back(it->second);
+  return result;
+}
+
+// The blocks of a discretization whose regions intersect all boxes
+set<const DiscretizationBlock *>
+findIntersecting(const Discretization &discretization,
+                 const vector<box_t> &boxes) {
+  set<const DiscretizationBlock *> result;
+  bool first = true;
+  for (const auto &box : boxes) {
+    set<const DiscretizationBlock *> box_result;
+    if (box.rank() == discretization.manifold.lock()->dimension)
+      for (const auto &db :
+           discretization.findDiscretizationBlocksIntersecting(box))
+        if (first || result.count(db.get()))
+          box_result.insert(db.get());
+    result = std::move(box_result);
+    first = false;
+  }
+  return result;
+}
+}
+
+Selection &Selection::field(const string &pattern) {
+  field_patterns.push_back(pattern);
+  return *this;
+}
+
+Selection &Selection::configuration(const string &pattern) {
+  configuration_patterns.push_back(pattern);
+  return *this;
+}
+
+Selection &Selection::parameter(const string &name, double minimum,
+                                double maximum) {
+  parameter_ranges.push_back({name, minimum, maximum});
+  return *this;
+}
+
+Selection &Selection::discretization(const string &pattern) {
+  discretization_patterns.push_back(pattern);
+  return *this;
+}
+
+Selection &Selection::tensorcomponent(const string &pattern) {
+  tensorcomponent_patterns.push_back(pattern);
+  return *this;
+}
+
+Selection &Selection::intersects(const box_t &box) {
+  assert(box.valid());
+  boxes.push_back(box);
+  return *this;
+}
+
+vector<shared_ptr<DiscreteField>> Selection::discretefields() const {
+  // Determine the selected configurations first, if they are restricted
+  const bool restricted =
+      !parameter_ranges.empty() || !configuration_patterns.empty();
+  map<string, shared_ptr<Configuration>> confs;
+  if (parameter_ranges.empty()) {
+    for (const auto &conf :
+         findMatching(project->configurations, configuration_patterns))
+      confs.emplace(conf->name, conf);
+  } else {
+    bool first = true;
+    for (const auto &range : parameter_ranges) {
+      map<string, shared_ptr<Configuration>> range_confs;
+      auto parit = project->parameters.find(range.name);
+      if (parit != project->parameters.end())
+        for (const auto &conf : parit->second->findConfigurations(
+                 range.minimum, range.maximum))
+          if ((first || confs.count(conf->name)) &&
+              matches(configuration_patterns, conf->name))
+            range_confs.emplace(conf->name, conf);
+      confs = std::move(range_confs);
+      first = false;
+    }
+  }
+
+  vector<shared_ptr<DiscreteField>> result;
+  auto select = [&](const shared_ptr<DiscreteField> &discretefield) {
+    if (matches(discretization_patterns, discretefield->discretization->name))
+      result.push_back(discretefield);
+  };
+  if (restricted) {
+    // Start from the configurations' discrete fields
+    for (const auto &conf : confs)
+      for (const auto &df : conf.second->discretefields) {
+        const auto &discretefield = df.second.lock();
+        if (matches(field_patterns, discretefield->field.lock()->name))
+          select(discretefield);
+      }
+  } else {
+    for (const auto &field : findMatching(project->fields, field_patterns))
+      for (const auto &df : field->discretefields)
+        select(df.second);
+  }
+  return result;
+}
+
+vector<shared_ptr<DiscreteFieldBlock>> Selection::discretefieldblocks() const {
+  vector<shared_ptr<DiscreteFieldBlock>> result;
+  // Discretizations are typically shared by many discrete fields
+  map<const Discretization *, set<const DiscretizationBlock *>> intersecting;
+  for (const auto &discretefield : discretefields()) {
+    const auto &discretization = *discretefield->discretization;
+    if (!boxes.empty() && !intersecting.count(&discretization))
+      intersecting[&discretization] = findIntersecting(discretization, boxes);
+    for (const auto &dfb : discretefield->discretefieldblocks)
+      if (boxes.empty() || intersecting.at(&discretization)
+                               .count(dfb.second->discretizationblock.get()))
+        result.push_back(dfb.second);
+  }
+  return result;
+}
+
+vector<shared_ptr<DiscreteFieldBlockComponent>> Selection::components() const {
+  vector<shared_ptr<DiscreteFieldBlockComponent>> result;
+  for (const auto &discretefieldblock : discretefieldblocks())
+    for (const auto &dfbc : discretefieldblock->discretefieldblockcomponents)
+      if (matches(tensorcomponent_patterns, dfbc.second->tensorcomponent->name))
+        result.push_back(dfbc.second);
+  return result;
+}
+}
@@ -0,0 +1,68 @@
+#ifndef SELECTION_HPP
+#define SELECTION_HPP
+
+#include "DiscretizationBlock.hpp"
+#include "Project.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SimulationIO {
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+struct DiscreteField;
+struct DiscreteFieldBlock;
+struct DiscreteFieldBlockComponent;
+
+// A query selecting discrete fields, discrete field blocks, or discrete field
+// block components of a project. All criteria have to be satisfied. Names are
+// matched against shell wildcard patterns such as "rho*". For example:
+//   project->select()
+//       .field("rho*")
+//       .parameter("iteration", 1024, 4096)
+//       .discretization("*level.03")
+//       .intersects(box)
+//       .components();
+// Parameter ranges are resolved via the parameter value indices, and name
+// patterns via ordered lookups on their literal prefix.
+struct Selection {
+  shared_ptr<const Project> project;
+
+  Selection(const shared_ptr<const Project> &project) : project(project) {}
+
+  Selection &field(const string &pattern);
+  Selection &configuration(const string &pattern);
+  Selection &parameter(const string &name, double minimum, double maximum);
+  Selection &discretization(const string &pattern);
+  Selection &tensorcomponent(const string &pattern);
+  // Select blocks whose region intersects the box, using the spatial index
+  // of the discretizations
+  Selection &intersects(const box_t &box);
+
+  vector<shared_ptr<DiscreteField>> discretefields() const;
+  vector<shared_ptr<DiscreteFieldBlock>> discretefieldblocks() const;
+  vector<shared_ptr<DiscreteFieldBlockComponent>> components() const;
+
+private:
+  struct parameter_range {
+    string name;
+    double minimum, maximum;
+  };
+  vector<string> field_patterns;
+  vector<string> configuration_patterns;
+  vector<parameter_range> parameter_ranges;
+  vector<string> discretization_patterns;
+  vector<string> tensorcomponent_patterns;
+  vector<box_t> boxes;
+};
+}
+
+#define SELECTION_HPP_DONE
+#endif // #ifndef SELECTION_HPP
+#ifndef SELECTION_HPP_DONE
+#error "Cyclic include depencency"
+#endif
@@ -19,6 +19,7 @@
 #include "Configuration.hpp"
 #include "CoordinateField.hpp"
 #include "CoordinateSystem.hpp"
+#include "DataCopy.hpp"
 #include "DiscreteField.hpp"
 #include "DiscreteFieldBlock.hpp"
 #include "DiscreteFieldBlockComponent.hpp"
@@ -29,6 +30,7 @@
 #include "Parameter.hpp"
 #include "ParameterValue.hpp"
 #include "Project.hpp"
+#include "Selection.hpp"
 #include "SubDiscretization.hpp"
 #include "TangentSpace.hpp"
 #include "TensorComponent.hpp"
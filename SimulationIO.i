@@ -76,6 +76,7 @@ struct Manifold;
 struct Parameter;
 struct ParameterValue;
 struct Project;
+struct Selection;
 struct SubDiscretization;
 struct TangentSpace;
 struct TensorComponent;
@@ -209,6 +210,18 @@ struct TensorType;
 
 %template(vector_double) std::vector<double>;
 %template(vector_int) std::vector<int>;
+%template(vector_shared_ptr_Configuration)
+  std::vector<std::shared_ptr<Configuration> >;
+%template(vector_shared_ptr_DiscreteField)
+  std::vector<std::shared_ptr<DiscreteField> >;
+%template(vector_shared_ptr_DiscreteFieldBlock)
+  std::vector<std::shared_ptr<DiscreteFieldBlock> >;
+%template(vector_shared_ptr_DiscreteFieldBlockComponent)
+  std::vector<std::shared_ptr<DiscreteFieldBlockComponent> >;
+%template(vector_shared_ptr_DiscretizationBlock)
+  std::vector<std::shared_ptr<DiscretizationBlock> >;
+%template(vector_shared_ptr_ParameterValue)
+  std::vector<std::shared_ptr<ParameterValue> >;
 
 %template(weak_ptr_Basis)
   std::weak_ptr<Basis>;
@@ -320,10 +333,13 @@ struct DiscreteField {
   std::map<string, std::shared_ptr<DiscreteFieldBlock> > discretefieldblocks;
   bool invariant() const;
 
+  std::vector<std::shared_ptr<DiscreteFieldBlock> >
+    orderedDiscreteFieldBlocks() const;
   std::shared_ptr<DiscreteFieldBlock>
     createDiscreteFieldBlock(const string& name,
                              const std::shared_ptr<DiscretizationBlock>&
                                discretizationblock);
+  void releaseDiscreteFieldBlock(const string& name);
 };
 
 struct DiscreteFieldBlock {
@@ -339,6 +355,7 @@ struct DiscreteFieldBlock {
     createDiscreteFieldBlockComponent(const string& name,
                                       const std::shared_ptr<TensorComponent>&
                                         tensorcomponent);
+  void releaseDiscreteFieldBlockComponent(const string& name);
 };
 
 struct DiscreteFieldBlockComponent {
@@ -351,7 +368,7 @@ struct DiscreteFieldBlockComponent {
   void setData(const H5::DataType &datatype, const H5::DataSpace& dataspace);
   %extend {
     H5::DataSet getData_DataSet() const {
-      return self->data_dataset;
+      return self->getDataSet();
     }
   }
   string getPath() const;
@@ -377,6 +394,24 @@ struct Discretization {
 
   std::shared_ptr<DiscretizationBlock>
     createDiscretizationBlock(const string& name);
+  %extend {
+    std::vector<std::shared_ptr<DiscretizationBlock> >
+      findDiscretizationBlocksContaining(const std::vector<int>& ipoint) const {
+      std::vector<hssize_t> hpoint(ipoint.size());
+      std::copy(ipoint.begin(), ipoint.end(), hpoint.begin());
+      return self->findDiscretizationBlocksContaining(point_t(hpoint));
+    }
+    std::vector<std::shared_ptr<DiscretizationBlock> >
+      findDiscretizationBlocksIntersecting(const std::vector<int>& ioffset,
+                                           const std::vector<int>& ishape)
+      const {
+      std::vector<hssize_t> hoffset(ioffset.size()), hshape(ishape.size());
+      std::copy(ioffset.begin(), ioffset.end(), hoffset.begin());
+      std::copy(ishape.begin(), ishape.end(), hshape.begin());
+      return self->findDiscretizationBlocksIntersecting(
+        box_t(hoffset, point_t(hoffset) + hshape));
+    }
+  }
 };
 
 struct DiscretizationBlock {
@@ -443,6 +478,13 @@ struct Parameter {
   bool invariant() const;
 
   std::shared_ptr<ParameterValue> createParameterValue(const string& name);
+  std::shared_ptr<ParameterValue> findParameterValue(double value) const;
+  std::vector<std::shared_ptr<ParameterValue> >
+    findParameterValues(double minimum, double maximum) const;
+  std::shared_ptr<ParameterValue>
+    findNearestParameterValue(double value) const;
+  std::vector<std::shared_ptr<Configuration> >
+    findConfigurations(double minimum, double maximum) const;
 };
 
 struct ParameterValue {
@@ -461,10 +503,36 @@ struct Project {
   std::map<string, std::shared_ptr<TangentSpace> > tangentspaces;
   std::map<string, std::shared_ptr<Field> > fields;
   std::map<string, std::shared_ptr<CoordinateSystem> > coordinatesystems;
+  enum layout_t { layout_full, layout_lean };
+  layout_t layout;
+  enum split_t { split_none, split_configuration, split_size, split_custom };
+  split_t split;
+  hsize_t split_size_cap;
   bool invariant() const;
+  bool validate(bool parallel = false) const;
+  %extend {
+    std::shared_ptr<DiscreteField>
+      lookupDiscreteField(const string& path) const {
+      return self->lookup<DiscreteField>(path);
+    }
+    std::shared_ptr<DiscreteFieldBlock>
+      lookupDiscreteFieldBlock(const string& path) const {
+      return self->lookup<DiscreteFieldBlock>(path);
+    }
+    std::shared_ptr<DiscreteFieldBlockComponent>
+      lookupDiscreteFieldBlockComponent(const string& path) const {
+      return self->lookup<DiscreteFieldBlockComponent>(path);
+    }
+  }
+  Selection select() const;
 
   void createStandardTensorTypes();
   void write(const H5::CommonFG& loc);
+  void append(const H5::CommonFG& loc);
+  void writeIncremental(const H5::CommonFG& loc);
+  void startStreaming(const H5::CommonFG& loc);
+  void finishStreaming();
+  bool streaming() const;
 
   std::shared_ptr<Parameter> createParameter(const string& name);
   std::shared_ptr<Configuration> createConfiguration(const string& name);
@@ -490,12 +558,35 @@ struct Project {
                            const std::shared_ptr<Manifold>& manifold);
 };
 std::shared_ptr<Project> createProject(const string& name);
-std::shared_ptr<Project> readProject(const H5::CommonFG &loc);
+std::shared_ptr<Project> readProject(const H5::CommonFG &loc,
+                                     bool metadata_only = false);
 // TODO: Support
 //    import h5py
 //    h5py.File(name,readwritetype).id.id
 // Do this as well for all other functions taking HDF5 objects as arguments.
 
+struct Selection {
+  Selection& field(const string& pattern);
+  Selection& configuration(const string& pattern);
+  Selection& parameter(const string& name, double minimum, double maximum);
+  Selection& discretization(const string& pattern);
+  Selection& tensorcomponent(const string& pattern);
+  %extend {
+    Selection& intersects(const std::vector<int>& ioffset,
+                          const std::vector<int>& ishape) {
+      std::vector<hssize_t> hoffset(ioffset.size()), hshape(ishape.size());
+      std::copy(ioffset.begin(), ioffset.end(), hoffset.begin());
+      std::copy(ishape.begin(), ishape.end(), hshape.begin());
+      return self->intersects(box_t(hoffset, point_t(hoffset) + hshape));
+    }
+  }
+  std::vector<std::shared_ptr<DiscreteField> > discretefields() const;
+  std::vector<std::shared_ptr<DiscreteFieldBlock> >
+    discretefieldblocks() const;
+  std::vector<std::shared_ptr<DiscreteFieldBlockComponent> >
+    components() const;
+};
+
 struct SubDiscretization {
   string name;
   std::weak_ptr<Manifold> manifold;
@@ -5,9 +5,62 @@
 #include "H5Helpers.hpp"
 
 #include <algorithm>
+#include <cmath>
 
 namespace SimulationIO {
 
+namespace {
+// Split a factor into integer refinement and coarsening factors
+void split_factor(const vector<double> &factor, point_t &refine,
+                  point_t &coarsen) {
+  vector<hssize_t> r(factor.size()), c(factor.size());
+  for (int d = 0; d < int(factor.size()); ++d) {
+    const double f = factor.at(d);
+    assert(f > 0);
+    if (f >= 1) {
+      r.at(d) = std::lrint(f);
+      c.at(d) = 1;
+      assert(double(r.at(d)) == f);
+    } else {
+      r.at(d) = 1;
+      c.at(d) = std::lrint(1 / f);
+      assert(double(c.at(d)) * f == 1);
+    }
+  }
+  refine = point_t(r);
+  coarsen = point_t(c);
+}
+
+point_t integer_offset(const vector<double> &offset) {
+  vector<hssize_t> o(offset.size());
+  for (int d = 0; d < int(offset.size()); ++d) {
+    o.at(d) = std::lrint(offset.at(d));
+    assert(double(o.at(d)) == offset.at(d));
+  }
+  return point_t(o);
+}
+}
+
+region_t SubDiscretization::child2parent(const region_t &child_region) const {
+  assert(child_region.rank() == int(factor.size()));
+  point_t refine, coarsen;
+  split_factor(factor, refine, coarsen);
+  // parent_idx = (child_idx + offset) / factor
+  return (child_region >> integer_offset(offset))
+      .refine(coarsen)
+      .coarsen(refine);
+}
+
+region_t
+SubDiscretization::parent2child(const region_t &parent_region) const {
+  assert(parent_region.rank() == int(factor.size()));
+  point_t refine, coarsen;
+  split_factor(factor, refine, coarsen);
+  // child_idx = factor * parent_idx - offset
+  return parent_region.refine(refine).coarsen(coarsen) <<
+         integer_offset(offset);
+}
+
 void SubDiscretization::read(const H5::CommonFG &loc, const string &entry,
                              const shared_ptr<Manifold> &manifold) {
   this->manifold = manifold;
@@ -16,17 +69,20 @@ void SubDiscretization::read(const H5::CommonFG &loc, const string &entry,
                                    manifold->project.lock()->enumtype) ==
          "SubDiscretization");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "manifold", "name") ==
-         manifold->name);
+  const bool lean = manifold->project.lock()->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "manifold", "name") ==
+                     manifold->name);
   parent_discretization = manifold->discretizations.at(
       H5::readGroupAttribute<string>(group, "parent_discretization", "name"));
-  assert(H5::readGroupAttribute<string>(
+  assert(lean ||
+         H5::readGroupAttribute<string>(
              group,
              string("parent_discretization/child_discretizations/") + name,
              "name") == name);
   child_discretization = manifold->discretizations.at(
       H5::readGroupAttribute<string>(group, "child_discretization", "name"));
-  assert(H5::readGroupAttribute<string>(
+  assert(lean ||
+         H5::readGroupAttribute<string>(
              group,
              string("child_discretization/parent_discretizations/") + name,
              "name") == name);
@@ -49,24 +105,26 @@ ostream &SubDiscretization::output(ostream &os, int level) const {
 
 void SubDiscretization::write(const H5::CommonFG &loc,
                               const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", manifold.lock()->project.lock()->enumtype,
                       "SubDiscretization");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "manifold", parent, ".");
   H5::createHardLink(group, "parent_discretization", parent,
                      string("discretizations/") + parent_discretization->name);
-  H5::createHardLink(group,
-                     string("manifold/discretizations/") +
-                         parent_discretization->name + "/child_discretizations",
-                     name, group, ".");
   H5::createHardLink(group, "child_discretization", parent,
                      string("discretizations/") + child_discretization->name);
-  H5::createHardLink(group,
-                     string("manifold/discretizations/") +
-                         child_discretization->name + "/parent_discretizations",
-                     name, group, ".");
+  if (manifold.lock()->project.lock()->layout == Project::layout_full) {
+    H5::createHardLink(group, "manifold", parent, ".");
+    H5::createHardLink(group, string("manifold/discretizations/") +
+                                  parent_discretization->name +
+                                  "/child_discretizations",
+                       name, group, ".");
+    H5::createHardLink(group, string("manifold/discretizations/") +
+                                  child_discretization->name +
+                                  "/parent_discretizations",
+                       name, group, ".");
+  }
   auto tmp_factor = factor;
   std::reverse(tmp_factor.begin(), tmp_factor.end());
   H5::createAttribute(group, "factor", tmp_factor);
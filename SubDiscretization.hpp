@@ -46,10 +46,19 @@ struct SubDiscretization : Common,
   vector<double> parent2child(const vector<double> &parent_idx) const {
     vector<double> child_idx(parent_idx.size());
     for (int d = 0; d < int(child_idx.size()); ++d)
-      child_idx.at(d) = factor.at(d) * child_idx.at(d) - offset.at(d);
+      child_idx.at(d) = factor.at(d) * parent_idx.at(d) - offset.at(d);
     return child_idx;
   }
 
+  // Map whole regions between the index spaces. This requires integer
+  // offsets, and factors that are integers (refinement) or inverse
+  // integers (coarsening). Coarsening yields the coarse points covering
+  // the region, e.g. the parent footprint of a refined region.
+  region_t child2parent(const region_t &child_region) const;
+  region_t parent2child(const region_t &parent_region) const;
+
+  virtual shared_ptr<const Common> getParent() const { return manifold.lock(); }
+
   virtual bool invariant() const {
     bool inv =
         Common::invariant() && bool(manifold.lock()) &&
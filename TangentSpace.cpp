@@ -14,13 +14,14 @@ void TangentSpace::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(group, "type", project->enumtype) ==
          "TangentSpace");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "project", "name") ==
-         project->name);
+  const bool lean = project->layout == Project::layout_lean;
+  assert(lean || H5::readGroupAttribute<string>(group, "project", "name") ==
+                     project->name);
   configuration = project->configurations.at(
       H5::readGroupAttribute<string>(group, "configuration", "name"));
-  assert(H5::readGroupAttribute<string>(
-             group, string("configuration/tangentspaces/") + name, "name") ==
-         name);
+  assert(lean || H5::readGroupAttribute<string>(
+                     group, string("configuration/tangentspaces/") + name,
+                     "name") == name);
   H5::readAttribute(group, "dimension", dimension);
   H5::readGroup(group, "bases",
                 [&](const H5::Group &group, const string &name) {
@@ -43,27 +44,42 @@ ostream &TangentSpace::output(ostream &os, int level) const {
 
 void TangentSpace::write(const H5::CommonFG &loc,
                          const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", project.lock()->enumtype, "TangentSpace");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "project", parent, ".");
+  const bool lean = project.lock()->layout == Project::layout_lean;
+  if (!lean)
+    H5::createHardLink(group, "project", parent, ".");
   H5::createHardLink(group, "configuration", parent,
                      string("configurations/") + configuration->name);
-  H5::createHardLink(group, string("project/configurations/") +
-                                configuration->name + "/tangentspaces",
-                     name, group, ".");
+  if (!lean)
+    H5::createHardLink(group, string("project/configurations/") +
+                                  configuration->name + "/tangentspaces",
+                       name, group, ".");
   H5::createAttribute(group, "dimension", dimension);
   H5::createGroup(group, "bases", bases);
-  group.createGroup("fields");
+  if (!lean)
+    group.createGroup("fields");
 }
 
+void TangentSpace::append(const H5::CommonFG &loc,
+                          const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "bases", bases);
+}
+
+string TangentSpace::getPath() const { return string("tangentspaces/") + name; }
+
 shared_ptr<Basis>
 TangentSpace::createBasis(const string &name,
                           const shared_ptr<Configuration> &configuration) {
   auto basis = Basis::create(name, shared_from_this(), configuration);
   checked_emplace(bases, basis->name, basis);
-  assert(basis->invariant());
+  project.lock()->insertPath(*this, "bases", basis);
+  basis->markDirty();
+  assert(basis->checkInvariant());
   return basis;
 }
 
@@ -71,7 +87,8 @@ shared_ptr<Basis> TangentSpace::readBasis(const H5::CommonFG &loc,
                                           const string &entry) {
   auto basis = Basis::create(loc, entry, shared_from_this());
   checked_emplace(bases, basis->name, basis);
-  assert(basis->invariant());
+  project.lock()->insertPath(*this, "bases", basis);
+  assert(basis->checkInvariant());
   return basis;
 }
 }
@@ -32,6 +32,8 @@ struct TangentSpace : Common, std::enable_shared_from_this<TangentSpace> {
   map<string, shared_ptr<Basis>> bases; // children
   map<string, weak_ptr<Field>> fields;  // backlinks
 
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     bool inv = Common::invariant() && bool(project.lock()) &&
                project.lock()->tangentspaces.count(name) &&
@@ -40,6 +42,10 @@ struct TangentSpace : Common, std::enable_shared_from_this<TangentSpace> {
                configuration->tangentspaces.count(name) &&
                configuration->tangentspaces.at(name).lock().get() == this &&
                dimension >= 0;
+    return inv;
+  }
+  virtual bool fullInvariant() const {
+    bool inv = invariant();
     for (const auto &b : bases)
       inv &= !b.first.empty() && bool(b.second);
     return inv;
@@ -86,6 +92,9 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<Basis> createBasis(const string &name,
                                 const shared_ptr<Configuration> &configuration);
@@ -12,8 +12,9 @@ void TensorComponent::read(const H5::CommonFG &loc, const string &entry,
                                    tensortype->project.lock()->enumtype) ==
          "TensorComponent");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "tensortype", "name") ==
-         tensortype->name);
+  assert(tensortype->project.lock()->layout == Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "tensortype", "name") ==
+             tensortype->name);
   H5::readAttribute(group, "storage_index", storage_index);
   H5::readAttribute(group, "indexvalues", indexvalues);
 }
@@ -27,13 +28,14 @@ ostream &TensorComponent::output(ostream &os, int level) const {
 
 void TensorComponent::write(const H5::CommonFG &loc,
                             const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type",
                       tensortype.lock()->project.lock()->enumtype,
                       "TensorComponent");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "tensortype", parent, ".");
+  if (tensortype.lock()->project.lock()->layout == Project::layout_full)
+    H5::createHardLink(group, "tensortype", parent, ".");
   H5::createAttribute(group, "storage_index", storage_index);
   H5::createAttribute(group, "indexvalues", indexvalues);
 }
@@ -28,6 +28,10 @@ struct TensorComponent : Common, std::enable_shared_from_this<TensorComponent> {
   NoBackLink<weak_ptr<DiscreteFieldBlockComponent>>
       discretefieldblockcomponents;
 
+  virtual shared_ptr<const Common> getParent() const {
+    return tensortype.lock();
+  }
+
   virtual bool invariant() const {
     bool inv =
         Common::invariant() && bool(tensortype.lock()) &&
@@ -42,6 +46,10 @@ struct TensorComponent : Common, std::enable_shared_from_this<TensorComponent> {
     for (int i = 0; i < int(indexvalues.size()); ++i)
       inv &=
           indexvalues[i] >= 0 && indexvalues[i] < tensortype.lock()->dimension;
+    return inv;
+  }
+  virtual bool fullInvariant() const {
+    bool inv = invariant();
     // Ensure all tensor components are distinct
     for (const auto &tc : tensortype.lock()->tensorcomponents) {
       const auto &other = tc.second;
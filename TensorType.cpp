@@ -13,8 +13,9 @@ void TensorType::read(const H5::CommonFG &loc, const string &entry,
   assert(H5::readAttribute<string>(group, "type", project->enumtype) ==
          "TensorType");
   H5::readAttribute(group, "name", name);
-  assert(H5::readGroupAttribute<string>(group, "project", "name") ==
-         project->name);
+  assert(project->layout == Project::layout_lean ||
+         H5::readGroupAttribute<string>(group, "project", "name") ==
+             project->name);
   H5::readAttribute(group, "dimension", dimension);
   H5::readAttribute(group, "rank", rank);
   H5::readGroup(group, "tensorcomponents",
@@ -34,26 +35,38 @@ ostream &TensorType::output(ostream &os, int level) const {
 
 void TensorType::write(const H5::CommonFG &loc,
                        const H5::H5Location &parent) const {
-  assert(invariant());
+  assert(checkInvariant());
   auto group = loc.createGroup(name);
   H5::createAttribute(group, "type", project.lock()->enumtype, "TensorType");
   H5::createAttribute(group, "name", name);
-  H5::createHardLink(group, "project", parent, ".");
+  if (project.lock()->layout == Project::layout_full)
+    H5::createHardLink(group, "project", parent, ".");
   H5::createAttribute(group, "dimension", dimension);
   H5::createAttribute(group, "rank", rank);
   H5::createGroup(group, "tensorcomponents", tensorcomponents);
 #warning "TODO: write storage_indices"
 }
 
+void TensorType::append(const H5::CommonFG &loc,
+                        const H5::H5Location &parent) const {
+  assert(checkInvariant());
+  auto group = loc.openGroup(name);
+  H5::appendGroup(group, "tensorcomponents", tensorcomponents);
+}
+
+string TensorType::getPath() const { return string("tensortypes/") + name; }
+
 shared_ptr<TensorComponent>
 TensorType::createTensorComponent(const string &name, int stored_component,
                                   const vector<int> &indexvalues) {
   auto tensorcomponent = TensorComponent::create(name, shared_from_this(),
                                                  stored_component, indexvalues);
   checked_emplace(tensorcomponents, tensorcomponent->name, tensorcomponent);
+  project.lock()->insertPath(*this, "tensorcomponents", tensorcomponent);
   checked_emplace(storage_indices, tensorcomponent->storage_index,
                   tensorcomponent);
-  assert(tensorcomponent->invariant());
+  tensorcomponent->markDirty();
+  assert(tensorcomponent->checkInvariant());
   return tensorcomponent;
 }
 
@@ -62,9 +75,10 @@ TensorType::readTensorComponent(const H5::CommonFG &loc, const string &entry) {
   auto tensorcomponent =
       TensorComponent::create(loc, entry, shared_from_this());
   checked_emplace(tensorcomponents, tensorcomponent->name, tensorcomponent);
+  project.lock()->insertPath(*this, "tensorcomponents", tensorcomponent);
   checked_emplace(storage_indices, tensorcomponent->storage_index,
                   tensorcomponent);
-  assert(tensorcomponent->invariant());
+  assert(tensorcomponent->checkInvariant());
   return tensorcomponent;
 }
 }
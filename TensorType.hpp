@@ -33,12 +33,18 @@ struct TensorType : Common, std::enable_shared_from_this<TensorType> {
   map<int, shared_ptr<TensorComponent>> storage_indices;
   NoBackLink<weak_ptr<Field>> fields;
 
+  virtual shared_ptr<const Common> getParent() const { return project.lock(); }
+
   virtual bool invariant() const {
     bool inv = Common::invariant() && bool(project.lock()) &&
                project.lock()->tensortypes.count(name) &&
                project.lock()->tensortypes.at(name).get() == this &&
                dimension >= 0 && rank >= 0 &&
                int(tensorcomponents.size()) <= ipow(dimension, rank);
+    return inv;
+  }
+  virtual bool fullInvariant() const {
+    bool inv = invariant();
     for (const auto &tc : tensorcomponents)
       inv &= !tc.first.empty() && bool(tc.second);
     return inv;
@@ -81,6 +87,9 @@ public:
   }
   virtual void write(const H5::CommonFG &loc,
                      const H5::H5Location &parent) const;
+  virtual void append(const H5::CommonFG &loc,
+                      const H5::H5Location &parent) const;
+  string getPath() const;
 
   shared_ptr<TensorComponent>
   createTensorComponent(const string &name, int storage_index,
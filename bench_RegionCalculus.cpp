@@ -0,0 +1,370 @@
+#include "RegionCalculus.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Micro-benchmarks for the region representations. Construction, set
+// operations, predicates, and conversions are timed for the box-list region
+// and the sweep-based region2 in one to four dimensions, on synthetic box
+// sets resembling AMR grid structures. The results are written as JSON, so
+// that runs can be compared across commits; they record the commit and
+// how the benchmark was built.
+//
+// Usage: bench_RegionCalculus [output.json]
+
+// Set by the Makefile
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+using namespace RegionCalculus;
+
+using std::ostream;
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Each operation is repeated until this much time has passed
+const double min_time = 0.1; // seconds
+
+struct result {
+  string representation;
+  int dim;
+  string boxset;
+  size_t nboxes;
+  string operation;
+  size_t iterations;
+  double seconds; // per iteration
+};
+vector<result> results;
+
+// Keep the compiler from discarding the benchmarked operations
+volatile long long sink;
+
+template <typename F>
+void measure(const string &representation, int dim, const string &boxset,
+             size_t nboxes, const string &operation, const F &f) {
+  typedef std::chrono::steady_clock clock;
+  size_t iterations = 0;
+  const auto t0 = clock::now();
+  std::chrono::duration<double> elapsed;
+  do {
+    sink = sink + (long long)(f());
+    ++iterations;
+    elapsed = clock::now() - t0;
+  } while (elapsed.count() < min_time);
+  results.push_back({representation, dim, boxset, nboxes, operation,
+                     iterations, elapsed.count() / iterations});
+  std::cerr << representation << " D=" << dim << " " << boxset << " "
+            << operation << ": " << elapsed.count() / iterations << " s\n";
+}
+
+// Fail the run if the representations disagree
+void check(bool success, int dim, const string &boxset,
+           const string &operation) {
+  if (success)
+    return;
+  std::cerr << "Error: region and region2 disagree for D=" << dim << " "
+            << boxset << " " << operation << "\n";
+  std::exit(EXIT_FAILURE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Box sets
+
+// Boxes of random shape at random locations
+template <int D>
+vector<box<int, D>> random_boxes(std::mt19937 &gen, int nboxes, int extent,
+                                 int maxsize) {
+  std::uniform_int_distribution<int> pos(0, extent - 1), size(1, maxsize);
+  vector<box<int, D>> boxes;
+  for (int n = 0; n < nboxes; ++n) {
+    point<int, D> lo, shape;
+    for (int d = 0; d < D; ++d) {
+      lo[d] = pos(gen);
+      shape[d] = size(gen);
+    }
+    boxes.push_back(box<int, D>(lo, lo + shape));
+  }
+  return boxes;
+}
+
+// Random boxes near a few cluster centres, as around refined features
+template <int D>
+vector<box<int, D>> clustered_boxes(std::mt19937 &gen, int nboxes, int extent,
+                                    int maxsize) {
+  const int nclusters = 8, radius = std::max(1, extent / 16);
+  std::uniform_int_distribution<int> pos(radius, extent - radius - 1),
+      offset(-radius, radius), size(1, maxsize), cluster(0, nclusters - 1);
+  vector<point<int, D>> centres(nclusters);
+  for (auto &centre : centres)
+    for (int d = 0; d < D; ++d)
+      centre[d] = pos(gen);
+  vector<box<int, D>> boxes;
+  for (int n = 0; n < nboxes; ++n) {
+    point<int, D> lo, shape;
+    const auto &centre = centres[cluster(gen)];
+    for (int d = 0; d < D; ++d) {
+      lo[d] = centre[d] + offset(gen);
+      shape[d] = size(gen);
+    }
+    boxes.push_back(box<int, D>(lo, lo + shape));
+  }
+  return boxes;
+}
+
+// Blocks of several refinement levels, each level covering the centre of
+// the next coarser one with the same number of blocks, in the index space
+// of the finest level
+template <int D>
+vector<box<int, D>> nested_boxes(int nlevels, int nblocks, int blocksize,
+                                 int shift) {
+  vector<box<int, D>> boxes;
+  const int width = nblocks * blocksize;
+  for (int l = 0; l < nlevels; ++l) {
+    const int scale = 1 << (nlevels - 1 - l);
+    const int offset = (width * (1 << l) - width) / 2 + shift;
+    for (int n = 0; n < int(std::pow(nblocks, D)); ++n) {
+      point<int, D> lo;
+      for (int d = 0, m = n; d < D; ++d, m /= nblocks)
+        lo[d] = offset + m % nblocks * blocksize;
+      boxes.push_back(box<int, D>(lo * point<int, D>(scale),
+                                  (lo + point<int, D>(blocksize)) *
+                                      point<int, D>(scale)));
+    }
+  }
+  return boxes;
+}
+
+// A coarse level of a regular grid of blocks, or its refinement of a
+// sphere in the centre, as in an AMR hierarchy, in the coarse level's index
+// space. The refined blocks are offset so that they do not align with the
+// coarse blocks.
+template <int D>
+vector<box<int, D>> sphere_boxes(int nblocks, int blocksize, bool refined) {
+  vector<box<int, D>> boxes;
+  for (int n = 0; n < int(std::pow(nblocks, D)); ++n) {
+    point<int, D> lo;
+    int r2 = 0;
+    for (int d = 0, m = n; d < D; ++d, m /= nblocks) {
+      lo[d] = m % nblocks * blocksize;
+      const int c = 2 * (m % nblocks) - nblocks + 1;
+      r2 += c * c;
+    }
+    if (!refined)
+      boxes.push_back(box<int, D>(lo, lo + point<int, D>(blocksize)));
+    else if (r2 < nblocks * nblocks / 4)
+      boxes.push_back(box<int, D>(lo + point<int, D>(blocksize / 4),
+                                  lo + point<int, D>(5 * blocksize / 4)));
+  }
+  return boxes;
+}
+
+// Every other block of a regular grid, which cannot be merged into larger
+// boxes
+template <int D>
+vector<box<int, D>> checkerboard_boxes(int nblocks, int blocksize,
+                                       int shift) {
+  vector<box<int, D>> boxes;
+  for (int n = 0; n < int(std::pow(nblocks, D)); ++n) {
+    point<int, D> lo;
+    int parity = 0;
+    for (int d = 0, m = n; d < D; ++d, m /= nblocks) {
+      lo[d] = m % nblocks * blocksize + shift;
+      parity += m % nblocks;
+    }
+    if (parity % 2 == 0)
+      boxes.push_back(box<int, D>(lo, lo + point<int, D>(blocksize)));
+  }
+  return boxes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmarks
+
+template <int D>
+void benchmark_boxset(const string &boxset, const vector<box<int, D>> &boxes0,
+                      const vector<box<int, D>> &boxes1) {
+  typedef region<int, D> region;
+  typedef region2<int, D> region2;
+  const size_t nboxes = boxes0.size();
+
+  // Normalize the (possibly overlapping) boxes once
+  const region2 s0(boxes0), s1(boxes1);
+  const region r0(vector<box<int, D>>(s0.operator vector<box<int, D>>()));
+  const region r1(vector<box<int, D>>(s1.operator vector<box<int, D>>()));
+  const vector<box<int, D>> &disjoint0 = r0.boxes;
+
+  // Both representations need to agree
+  check(region(vector<box<int, D>>(s0 & s1)) == (r0 & r1), D, boxset,
+        "intersection");
+  check(region(vector<box<int, D>>(s0 | s1)) == (r0 | r1), D, boxset,
+        "union");
+  check(region(vector<box<int, D>>(s0 - s1)) == (r0 - r1), D, boxset,
+        "difference");
+  check(region(vector<box<int, D>>(s0 ^ s1)) == (r0 ^ r1), D, boxset,
+        "symmetric_difference");
+
+  // Points for membership tests
+  std::mt19937 gen(D);
+  const box<int, D> bbox = r0.bounding_box();
+  vector<point<int, D>> points(100);
+  for (auto &p : points)
+    for (int d = 0; d < D; ++d)
+      p[d] = std::uniform_int_distribution<int>(bbox.lower()[d],
+                                                bbox.upper()[d] - 1)(gen);
+
+  measure("region", D, boxset, nboxes, "construction",
+          [&]() { return region(disjoint0).boxes.size(); });
+  measure("region", D, boxset, nboxes, "intersection",
+          [&]() { return (r0 & r1).boxes.size(); });
+  measure("region", D, boxset, nboxes, "union",
+          [&]() { return (r0 | r1).boxes.size(); });
+  measure("region", D, boxset, nboxes, "difference",
+          [&]() { return (r0 - r1).boxes.size(); });
+  measure("region", D, boxset, nboxes, "symmetric_difference",
+          [&]() { return (r0 ^ r1).boxes.size(); });
+  measure("region", D, boxset, nboxes, "size",
+          [&]() { return r0.size(); });
+  measure("region", D, boxset, nboxes, "bounding_box",
+          [&]() { return r0.bounding_box().size(); });
+  measure("region", D, boxset, nboxes, "contains", [&]() {
+    size_t count = 0;
+    for (const auto &p : points)
+      count += r0.contains(p);
+    return count;
+  });
+  measure("region", D, boxset, nboxes, "to_region2",
+          [&]() { return region2::from_disjoint(r0.boxes).nentries(); });
+
+  measure("region2", D, boxset, nboxes, "construction",
+          [&]() { return region2::from_disjoint(disjoint0).nentries(); });
+  measure("region2", D, boxset, nboxes, "construction_overlapping",
+          [&]() { return region2(boxes0).nentries(); });
+  measure("region2", D, boxset, nboxes, "intersection",
+          [&]() { return (s0 & s1).nentries(); });
+  measure("region2", D, boxset, nboxes, "union",
+          [&]() { return (s0 | s1).nentries(); });
+  measure("region2", D, boxset, nboxes, "difference",
+          [&]() { return (s0 - s1).nentries(); });
+  measure("region2", D, boxset, nboxes, "symmetric_difference",
+          [&]() { return (s0 ^ s1).nentries(); });
+  measure("region2", D, boxset, nboxes, "size",
+          [&]() { return s0.size(); });
+  measure("region2", D, boxset, nboxes, "bounding_box",
+          [&]() { return s0.bounding_box().size(); });
+  measure("region2", D, boxset, nboxes, "contains", [&]() {
+    size_t count = 0;
+    for (const auto &p : points)
+      count += s0.contains(p);
+    return count;
+  });
+  measure("region2", D, boxset, nboxes, "to_region", [&]() {
+    return region(vector<box<int, D>>(s0.operator vector<box<int, D>>()))
+        .boxes.size();
+  });
+}
+
+template <int D> void benchmark_dim() {
+  // Use fewer boxes in higher dimensions, where the box-list region scales
+  // badly, to keep the total run time within a few minutes
+  const int nboxes = D <= 2 ? 1000 : D == 3 ? 500 : 200, maxsize = 10;
+  const int extent = int(2 * maxsize * std::pow(nboxes, 1.0 / D));
+  const int nblocks = int(std::lround(std::pow(2 * nboxes, 1.0 / D)));
+  const int nlevels = 3, nlevelblocks = std::max(
+                             2, int(std::lround(std::pow(nboxes / nlevels,
+                                                         1.0 / D))));
+  const int blocksize = 8;
+  std::mt19937 gen(1);
+  {
+    const auto boxes0 = random_boxes<D>(gen, nboxes, extent, maxsize);
+    const auto boxes1 = random_boxes<D>(gen, nboxes, extent, maxsize);
+    benchmark_boxset<D>("random", boxes0, boxes1);
+  }
+  {
+    const auto boxes0 = clustered_boxes<D>(gen, nboxes, extent, maxsize);
+    const auto boxes1 = clustered_boxes<D>(gen, nboxes, extent, maxsize);
+    benchmark_boxset<D>("clustered", boxes0, boxes1);
+  }
+  benchmark_boxset<D>(
+      "nested", nested_boxes<D>(nlevels, nlevelblocks, blocksize, 0),
+      nested_boxes<D>(nlevels, nlevelblocks, blocksize, blocksize / 2));
+  benchmark_boxset<D>(
+      "checkerboard", checkerboard_boxes<D>(nblocks, blocksize, 0),
+      checkerboard_boxes<D>(nblocks, blocksize, blocksize / 2));
+  // A coarse level of 4096 blocks (16^3 in three dimensions) and a refined
+  // sphere
+  const int nsphereblocks = int(std::lround(std::pow(4096, 1.0 / D)));
+  const int sphereblocksize = 16;
+  benchmark_boxset<D>(
+      "sphere", sphere_boxes<D>(nsphereblocks, sphereblocksize, false),
+      sphere_boxes<D>(nsphereblocks, sphereblocksize, true));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Output
+
+void write_json(ostream &os) {
+  os << "{\n"
+     << "  \"benchmark\": \"RegionCalculus\",\n"
+     << "  \"commit\": \"" << BENCH_COMMIT << "\",\n"
+     << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+#ifdef __OPTIMIZE__
+     << "  \"optimized\": true,\n"
+#else
+     << "  \"optimized\": false,\n"
+#endif
+#ifdef NDEBUG
+     << "  \"assertions\": false,\n"
+#else
+     << "  \"assertions\": true,\n"
+#endif
+     << "  \"debug_checks\": " << (REGIONCALCULUS_DEBUG ? "true" : "false")
+     << ",\n"
+     << "  \"min_time\": " << min_time << ",\n"
+     << "  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &r = results[i];
+    os << "    {\"representation\": \"" << r.representation << "\", "
+       << "\"dim\": " << r.dim << ", "
+       << "\"boxset\": \"" << r.boxset << "\", "
+       << "\"nboxes\": " << r.nboxes << ", "
+       << "\"operation\": \"" << r.operation << "\", "
+       << "\"iterations\": " << r.iterations << ", "
+       << "\"seconds\": " << r.seconds << "}"
+       << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "  ]\n"
+     << "}\n";
+}
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    std::cerr << "Usage: " << argv[0] << " [output.json]\n";
+    return 1;
+  }
+
+  benchmark_dim<1>();
+  benchmark_dim<2>();
+  benchmark_dim<3>();
+  benchmark_dim<4>();
+
+  if (argc == 2) {
+    std::ofstream file(argv[1]);
+    write_json(file);
+  } else {
+    write_json(std::cout);
+  }
+  return 0;
+}
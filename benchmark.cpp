@@ -1,5 +1,6 @@
 #include "SimulationIO.hpp"
 
+#include <cassert>
 #include <chrono>
 #include <iostream>
 #include <memory>
@@ -17,6 +18,13 @@ using std::vector;
 
 const char *const dirnames[] = {"x", "y", "z"};
 
+// H5Lvisit visits every group only once, so that this counts all links
+herr_t count_links(hid_t group, const char *name, const H5L_info_t *info,
+                   void *op_data) {
+  ++*static_cast<hsize_t *>(op_data);
+  return 0;
+}
+
 int main(int argc, char **argv) {
 
   std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -86,33 +94,54 @@ int main(int argc, char **argv) {
   }
 
   const auto t1 = std::chrono::system_clock::now();
+  const std::chrono::duration<double> time_create = t1 - t0;
+  cout << "Create time: " << time_create.count() << "\n";
+
+  // Write and read the file in both on-disk layouts
+  for (auto layout : {Project::layout_full, Project::layout_lean}) {
+    const bool lean = layout == Project::layout_lean;
+    project->layout = layout;
+
+    const auto t1 = std::chrono::system_clock::now();
+
+    // Write file
+    auto filename = lean ? "benchmark-lean.s5" : "benchmark.s5";
+    {
+      auto fapl = H5::FileAccPropList();
+      fapl.setLibverBounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+      auto file = H5::H5File(filename, H5F_ACC_TRUNC,
+                             H5::FileCreatPropList::DEFAULT, fapl);
+      project->write(file);
+    }
 
-  // Write file
-  auto filename = "benchmark.s5";
-  {
-    auto fapl = H5::FileAccPropList();
-    fapl.setLibverBounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
-    auto file = H5::H5File(filename, H5F_ACC_TRUNC,
-                           H5::FileCreatPropList::DEFAULT, fapl);
-    project->write(file);
-  }
+    const auto t2 = std::chrono::system_clock::now();
 
-  const auto t2 = std::chrono::system_clock::now();
+    // Read file
+    {
+      auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+      auto project2 = readProject(file);
+    }
 
-  // Read file
-  {
-    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
-    auto project2 = readProject(file);
-  }
+    const auto t3 = std::chrono::system_clock::now();
 
-  const auto t3 = std::chrono::system_clock::now();
+    // Measure metadata footprint
+    hsize_t nlinks = 0, filesize;
+    {
+      auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+      herr_t herr = H5Lvisit(file.getId(), H5_INDEX_NAME, H5_ITER_NATIVE,
+                             count_links, &nlinks);
+      assert(!herr);
+      filesize = file.getFileSize();
+    }
 
-  const std::chrono::duration<double> time_create = t1 - t0;
-  const std::chrono::duration<double> time_write = t2 - t1;
-  const std::chrono::duration<double> time_read = t3 - t2;
-  cout << "Create time: " << time_create.count() << "\n"
-       << "Write time: " << time_write.count() << "\n"
-       << "Read time: " << time_read.count() << "\n";
+    const std::chrono::duration<double> time_write = t2 - t1;
+    const std::chrono::duration<double> time_read = t3 - t2;
+    cout << "Layout: " << (lean ? "lean" : "full") << "\n"
+         << "  Write time: " << time_write.count() << "\n"
+         << "  Read time: " << time_read.count() << "\n"
+         << "  Links: " << nlinks << "\n"
+         << "  File size: " << filesize << "\n";
+  }
 
   return 0;
 }
@@ -20,8 +20,6 @@
 using namespace SimulationIO;
 using namespace std;
 
-typedef RegionCalculus::dpoint<hssize_t> dpoint;
-typedef RegionCalculus::dbox<hssize_t> dbox;
 typedef RegionCalculus::dregion<hssize_t> dregion;
 
 const char *const dirnames[] = {"x", "y", "z"};
@@ -180,6 +178,7 @@ int main(int argc, char **argv) {
 
   bool have_error = false;
   enum { action_unset, action_copy, action_extlink } action = action_unset;
+  bool split = false;
   string outputfilename;
   vector<string> inputfilenames;
 
@@ -201,6 +200,8 @@ int main(int argc, char **argv) {
           break;
         }
         action = action_extlink;
+      } else if (argvi == "--split") {
+        split = true;
       } else {
         have_error = true;
         break;
@@ -218,7 +219,8 @@ int main(int argc, char **argv) {
   }
   if (have_error) {
     cerr << "Synposis:\n" << argv[0]
-         << " [--copy|--extlink] <output file name> {<input file name>}\n";
+         << " [--copy|--extlink] [--split] <output file name> "
+            "{<input file name>}\n";
     return 1;
   }
   if (action == action_unset) {
@@ -231,6 +233,9 @@ int main(int argc, char **argv) {
   // Project
   const string projectname = basename;
   auto project = createProject(projectname);
+  // Place the data of each iteration into a separate data file
+  if (split)
+    project->split = Project::split_configuration;
   // Parameters
   auto parameter_iteration = project->createParameter("iteration");
   auto parameter_timelevel = project->createParameter("timelevel");
@@ -392,22 +397,26 @@ int main(int argc, char **argv) {
             istringstream ibuf(active_str);
             ibboxset active_bs;
             ibuf >> active_bs;
-            vector<dbox> dbs;
+            // Carpet's bboxes are three-dimensional; convert them with
+            // statically typed points, and wrap the region only once
+            typedef RegionCalculus::point<hssize_t, 3> ipoint;
+            typedef RegionCalculus::box<hssize_t, 3> ibox;
+            const ipoint poffsetnum(ioffsetnum);
+            const ipoint poffsetdenom(ioffsetdenom);
+            vector<ibox> boxes;
+            boxes.reserve(active_bs.elts.size());
             for (const ibbox &b : active_bs.elts) {
-              dpoint lo(b.lower.elts);
-              dpoint hi(b.upper.elts);
-              const dpoint str(b.stride.elts);
+              ipoint lo(b.lower.elts);
+              ipoint hi(b.upper.elts);
+              const ipoint str(b.stride.elts);
               hi += str;
-              const dpoint poffsetnum(ioffsetnum);
-              const dpoint poffsetdenom(ioffsetdenom);
               assert(all(!(str % poffsetdenom)));
               lo -= str * poffsetnum / poffsetdenom;
               hi -= str * poffsetnum / poffsetdenom;
               assert(all(!(lo % str) && !(hi % str)));
-              const dbox db(lo / str, hi / str);
-              dbs.push_back(db);
+              boxes.push_back(ibox(lo / str, hi / str));
             }
-            active = dregion(dbs);
+            active = dregion(RegionCalculus::region<hssize_t, 3>(boxes));
           }
 
           // Output information
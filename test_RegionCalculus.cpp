@@ -2,9 +2,12 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <sstream>
+#include <type_traits>
 
 using std::equal_to;
 using std::ostringstream;
@@ -181,6 +184,10 @@ TEST(RegionCalculus, region) {
       EXPECT_TRUE(rintersection == rj.intersection(ri));
       EXPECT_TRUE(rsetunion == rj.setunion(ri));
       EXPECT_TRUE(rsymmetric_difference == rj.symmetric_difference(ri));
+      EXPECT_TRUE(rintersection == ri.intersection(rj, true));
+      EXPECT_TRUE(rdifference == ri.difference(rj, true));
+      EXPECT_TRUE(rsetunion == ri.setunion(rj, true));
+      EXPECT_TRUE(rsymmetric_difference == ri.symmetric_difference(rj, true));
       if (ri == rj) {
         EXPECT_TRUE(rintersection == ri);
         EXPECT_TRUE(rdifference.empty());
@@ -194,6 +201,203 @@ TEST(RegionCalculus, region) {
   EXPECT_EQ("{([0,0,0]:[1,1,1]),([1,1,1]:[2,2,2])}", buf.str());
 }
 
+TEST(RegionCalculus, for_each) {
+  typedef point<int, 3> point;
+  typedef box<int, 3> box;
+  typedef region<int, 3> region;
+  const box within(point(-1, 0, 1), point(4, 5, 6));
+  const box b(point(0, 1, 2), point(3, 2, 5));
+  vector<int> visited(within.size(), 0);
+  point oldp;
+  bool first = true;
+  for_each_linear(b, within, [&](const point &p, std::ptrdiff_t idx) {
+    EXPECT_TRUE(b.contains(p));
+    if (!first) {
+      EXPECT_TRUE(oldp.less(p));
+    }
+    oldp = p;
+    first = false;
+    const point q = p - within.lower();
+    EXPECT_EQ(q[0] + 5 * (q[1] + 5 * q[2]), idx);
+    ++visited.at(idx);
+  });
+  int count = 0;
+  for (const auto v : visited) {
+    EXPECT_TRUE(v == 0 || v == 1);
+    count += v;
+  }
+  EXPECT_EQ(b.size(), count);
+  int nruns = 0;
+  for_each_run(b, within, [&](const point &p, std::ptrdiff_t idx, int n) {
+    EXPECT_EQ(3, n);
+    ++nruns;
+  });
+  EXPECT_EQ(3, nruns);
+  const region r(vector<box>{b, box(point(0, 3, 1), point(2, 5, 2))});
+  count = 0;
+  for_each(r, [&](const point &p) {
+    EXPECT_TRUE(r.contains(p));
+    ++count;
+  });
+  EXPECT_EQ(r.size(), count);
+  count = 0;
+  for_each(box(), [&](const point &p) { ++count; });
+  EXPECT_EQ(0, count);
+}
+
+TEST(RegionCalculus, sfc) {
+  // Both curves enumerate the grid; the Hilbert curve moves to a
+  // neighbouring point at each step
+  for (const auto curve : {sfc_t::morton, sfc_t::hilbert}) {
+    const int nbits = 3, n = 1 << nbits;
+    vector<array<std::uint64_t, 3>> points(n * n * n);
+    vector<bool> seen(n * n * n, false);
+    for (int k = 0; k < n; ++k)
+      for (int j = 0; j < n; ++j)
+        for (int i = 0; i < n; ++i) {
+          const array<std::uint64_t, 3> x{{std::uint64_t(i), std::uint64_t(j),
+                                           std::uint64_t(k)}};
+          const auto idx = sfc_index<3>(x, nbits, curve);
+          ASSERT_LT(idx, points.size());
+          EXPECT_FALSE(seen[idx]);
+          seen[idx] = true;
+          points[idx] = x;
+        }
+    if (curve == sfc_t::hilbert)
+      for (std::size_t idx = 1; idx < points.size(); ++idx) {
+        int dist = 0;
+        for (int d = 0; d < 3; ++d)
+          dist += std::abs(int(points[idx][d]) - int(points[idx - 1][d]));
+        EXPECT_EQ(1, dist);
+      }
+  }
+
+  typedef point<int, 2> point;
+  typedef box<int, 2> box;
+  typedef region<int, 2> region;
+  vector<box> bs;
+  for (int j = 0; j < 4; ++j)
+    for (int i = 0; i < 4; ++i)
+      bs.push_back(box(point(vector<int>{2 * i, 2 * j}),
+                       point(vector<int>{2 * i + 2, 2 * j + 2})));
+  std::reverse(bs.begin(), bs.end());
+  for (const auto curve : {sfc_t::morton, sfc_t::hilbert}) {
+    auto sorted = bs;
+    sfc_sort(sorted, curve);
+    EXPECT_EQ(region(bs), region(sorted));
+    EXPECT_TRUE(all(sorted.front().lower() == point(0)));
+  }
+
+  box b(point(vector<int>{1, 2}), point(vector<int>{6, 5}));
+  for (int n = 0; n <= b.size(); ++n) {
+    vector<box> head, tail;
+    split_box(b, n, head, tail);
+    EXPECT_LE(head.size(), 2U);
+    EXPECT_LE(tail.size(), 2U);
+    const region rh(head), rt(tail);
+    EXPECT_EQ(n, rh.size());
+    EXPECT_TRUE(rh.isdisjoint(rt));
+    EXPECT_EQ(region(b), rh | rt);
+    if (n > 0 && n < b.size()) {
+      EXPECT_EQ(linear_index(head.back().upper() - point(1), b) + 1,
+                linear_index(tail.front().lower(), b));
+    }
+  }
+
+  region r;
+  for (int i = 0; i < 20; ++i) {
+    const point lo(vector<int>{irand(20), irand(20)});
+    r = r | region(box(lo, lo + point(vector<int>{irand(10), irand(10)})));
+  }
+  for (const auto curve : {sfc_t::morton, sfc_t::hilbert})
+    for (int npieces : {1, 3, 7, 100}) {
+      const auto pieces = partition(r, npieces, curve);
+      ASSERT_EQ(std::size_t(npieces), pieces.size());
+      region all;
+      for (const auto &piece : pieces) {
+        EXPECT_LE(std::abs(piece.size() - r.size() / npieces), 1);
+        EXPECT_TRUE(all.isdisjoint(piece));
+        all = all | piece;
+      }
+      EXPECT_EQ(r, all);
+    }
+}
+
+TEST(RegionCalculus, morphology) {
+  typedef point<int, 2> point;
+  typedef box<int, 2> box;
+  typedef region<int, 2> region;
+  const box b(point(vector<int>{-3, 1}), point(vector<int>{2, 4}));
+  EXPECT_EQ(box(point(vector<int>{-4, -1}), point(vector<int>{4, 5})),
+            b.grow(point(vector<int>{1, 2}), point(vector<int>{2, 1})));
+  EXPECT_EQ(box(point(vector<int>{-2, 2}), point(vector<int>{1, 3})),
+            b.shrink(1));
+  EXPECT_TRUE(b.shrink(2).empty());
+  EXPECT_EQ(box(point(vector<int>{-2, 0}), point(vector<int>{1, 2})),
+            b.coarsen(point(2)));
+  EXPECT_EQ(box(point(vector<int>{-6, 2}), point(vector<int>{4, 8})),
+            b.refine(point(2)));
+
+  region r;
+  for (int n = 0; n < 5; ++n) {
+    const point lo(vector<int>{irand(12) - 6, irand(12) - 6});
+    r = r | region(box(lo, lo + point(vector<int>{irand(6), irand(6)})));
+  }
+  const point dlo(vector<int>{1, 0}), dhi(vector<int>{2, 3});
+  const point f(vector<int>{2, 3});
+  const region rgrow = r.grow(dlo, dhi), rshrink = r.shrink(dlo, dhi),
+               rcoarsen = r.coarsen(f), rrefine = r.refine(f);
+  EXPECT_EQ(rgrow, region(vector<box>(
+                       region2<int, 2>(r.boxes).grow(dlo, dhi))));
+  EXPECT_EQ(r, (r >> dlo) << dlo);
+  EXPECT_EQ(r, rrefine.coarsen(f));
+  EXPECT_TRUE(r <= r.grow(1));
+  EXPECT_TRUE(r.shrink(1) <= r);
+  EXPECT_TRUE(r.grow(2).shrink(2) >= r);
+  for (int j = -20; j < 20; ++j)
+    for (int i = -20; i < 20; ++i) {
+      const point p(vector<int>{i, j});
+      EXPECT_EQ(!r.isdisjoint(box(p - dhi, p + dlo + point(1))),
+                rgrow.contains(p));
+      EXPECT_EQ(region(box(p - dlo, p + dhi + point(1))) <= r,
+                rshrink.contains(p));
+      EXPECT_EQ(!r.isdisjoint(box(p * f, p * f + f)), rcoarsen.contains(p));
+      const point q(vector<int>{detail::div_floor(i, f[0]),
+                                detail::div_floor(j, f[1])});
+      EXPECT_EQ(r.contains(q), rrefine.contains(p));
+    }
+}
+
+TEST(RegionCalculus, chunks) {
+  typedef point<int, 2> point;
+  typedef box<int, 2> box;
+  typedef region<int, 2> region;
+  const chunk_grid<int, 2> grid(point(vector<int>{-1, 0}),
+                                point(vector<int>{4, 3}));
+  EXPECT_TRUE(all(grid.chunk(point(vector<int>{-2, 2})) ==
+                  point(vector<int>{-1, 0})));
+  EXPECT_EQ(box(point(vector<int>{3, 3}), point(vector<int>{7, 6})),
+            grid.chunk_box(point(1)));
+  const region r = region(box(point(vector<int>{0, 1}),
+                              point(vector<int>{9, 4}))) |
+                   region(box(point(vector<int>{-3, 5}),
+                              point(vector<int>{2, 6})));
+  const auto chunks = chunk_decomposition(r, grid);
+  EXPECT_EQ(7, chunks.size());
+  region all;
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    if (i > 0) {
+      EXPECT_TRUE(chunks[i - 1].first.less(chunks[i].first));
+    }
+    const region chunk(chunks[i].second);
+    EXPECT_TRUE(chunk <= region(grid.chunk_box(chunks[i].first)));
+    EXPECT_FALSE(chunk.empty());
+    EXPECT_TRUE(all.isdisjoint(chunk));
+    all = all | chunk;
+  }
+  EXPECT_EQ(r, all);
+}
+
 TEST(RegionCalculus, region2) {
   typedef point<int, 3> point;
   typedef box<int, 3> box;
@@ -250,6 +454,51 @@ TEST(RegionCalculus, region2) {
   region2 r12(r12vals);
   vector<box> r12boxes = r12;
   EXPECT_EQ(r12vals, r12boxes);
+  EXPECT_EQ(b2, r12.bounding_box());
+  EXPECT_EQ(box(p, point(4)), region2(box(p, point(4))).bounding_box());
+  EXPECT_TRUE(r1.less(r12) != r12.less(r1));
+  EXPECT_FALSE(r12.less(r12));
+  for (int i = 0; i < 10; ++i) {
+    // Overlapping boxes
+    vector<box> bs;
+    region2 rsum;
+    for (int n = irand(50); n >= 0; --n) {
+      bs.push_back(box(point(irand(10), irand(10), irand(10)),
+                       point(irand(10), irand(10), irand(10))));
+      rsum |= region2(bs.back());
+    }
+    EXPECT_EQ(rsum, region2(bs));
+    EXPECT_EQ(rsum, region2(bs, true));
+    // Disjoint boxes
+    vector<box> dbs;
+    for (int k = 0; k < 5; ++k)
+      for (int j = 0; j < 5; ++j)
+        for (int i = 0; i < 5; ++i)
+          if (irand(2))
+            dbs.push_back(box(point(2 * i, 2 * j, 2 * k),
+                              point(2 * i + 1 + (irand(2) > 0),
+                                    2 * j + 1 + (irand(2) > 0),
+                                    2 * k + 1 + (irand(2) > 0))));
+    const auto rdisjoint = region2::from_disjoint(dbs);
+    EXPECT_TRUE(rdisjoint.invariant());
+    EXPECT_EQ(region2(dbs), rdisjoint);
+  }
+  {
+    // Enough boxes to use multiple threads
+    vector<box> bs, bs1;
+    for (int n = 0; n < 2500; ++n) {
+      point lo(irand(100), irand(100), irand(100));
+      bs.push_back(box(lo, lo + point(1 + irand(5))));
+      point lo1(irand(100), irand(100), irand(100));
+      bs1.push_back(box(lo1, lo1 + point(1 + irand(5))));
+    }
+    const region2 rbs(bs), rbs1(bs1);
+    EXPECT_EQ(rbs, region2(bs, true));
+    EXPECT_EQ(rbs & rbs1, rbs.intersection(rbs1, true));
+    EXPECT_EQ(rbs - rbs1, rbs.difference(rbs1, true));
+    EXPECT_EQ(rbs | rbs1, rbs.setunion(rbs1, true));
+    EXPECT_EQ(rbs ^ rbs1, rbs.symmetric_difference(rbs1, true));
+  }
   vector<region2> rs;
   rs.push_back(r);
   rs.push_back(r1);
@@ -331,6 +580,72 @@ TEST(RegionCalculus, region2) {
   EXPECT_EQ("{([0,0,0]:[1,1,1]),([1,1,1]:[2,2,2])}", buf.str());
 }
 
+TEST(RegionCalculus, hregion) {
+  typedef point<int, 3> point;
+  typedef box<int, 3> box;
+  typedef region<int, 3> region;
+  typedef hregion<int, 3> hregion;
+  hregion h;
+  EXPECT_TRUE(h.invariant());
+  EXPECT_TRUE(h.empty());
+  // Splitting a box yields the same node
+  const box b(point(0), point(10));
+  const hregion hb(b);
+  EXPECT_TRUE(hb.invariant());
+  EXPECT_EQ(1000, hb.size());
+  vector<box> slabs;
+  for (int i = 0; i < 10; ++i)
+    slabs.push_back(box(point(0, 0, i), point(10, 10, i + 1)));
+  EXPECT_EQ(hb, hregion(slabs));
+  EXPECT_EQ(hb.root, hregion(slabs).root);
+  EXPECT_EQ(hb.root->sections[0], hregion(slabs).root->sections[0]);
+  EXPECT_EQ(region(b), region(hb));
+  // Compare set operations to the box-list region
+  vector<region> rs;
+  for (int n = 0; n < 6; ++n) {
+    vector<box> bs;
+    for (int m = 0; m < 5; ++m) {
+      const point lo(irand(10), irand(10), irand(10));
+      bs.push_back(box(lo, lo + point(irand(5), irand(5), irand(5))));
+    }
+    region r;
+    for (const auto &b : bs)
+      r = r | region(b);
+    EXPECT_EQ(r, region(hregion(bs)));
+    rs.push_back(r);
+  }
+  for (const auto &ri : rs)
+    for (const auto &rj : rs) {
+      const hregion hi(ri), hj(rj);
+      EXPECT_TRUE((hi & hj).invariant());
+      EXPECT_EQ(ri & rj, region(hi & hj));
+      EXPECT_EQ(ri | rj, region(hi | hj));
+      EXPECT_EQ(ri - rj, region(hi - hj));
+      EXPECT_EQ(ri ^ rj, region(hi ^ hj));
+      EXPECT_EQ((ri & rj).size(), (hi & hj).size());
+      EXPECT_EQ(ri == rj, hi == hj);
+      EXPECT_EQ(ri <= rj, hi <= hj);
+      // Repeated operations are memoized
+      EXPECT_EQ((hi | hj).root, (hi | hj).root);
+      for (int n = 0; n < 10; ++n) {
+        const point p(irand(15), irand(15), irand(15));
+        EXPECT_EQ(ri.contains(p), hi.contains(p));
+      }
+    }
+  // Memoized results do not keep their nodes alive
+  std::weak_ptr<const hregion::node> result;
+  {
+    const hregion ha(box(point(20), point(30))), hc(box(point(25), point(35)));
+    const hregion hu = ha | hc;
+    result = hu.root;
+    EXPECT_EQ(hu.root, (ha | hc).root);
+  }
+  EXPECT_TRUE(result.expired());
+  ostringstream buf;
+  buf << hregion(box(point(0), point(1)));
+  EXPECT_EQ("{([0,0,0]:[1,1,1])}", buf.str());
+}
+
 TEST(RegionCalculus, dpoint) {
   const int dim = 3;
   typedef dpoint<int> dpoint;
@@ -412,11 +727,25 @@ TEST(RegionCalculus, dbox) {
   EXPECT_TRUE(b1.intersection(b5).empty());
   EXPECT_TRUE(b.intersection(b5).empty());
   EXPECT_TRUE(b1.intersection(b).empty());
+  EXPECT_EQ(b5, dbox(b5.to_vbox()));
+  EXPECT_EQ(b5, dbox(b5.get<dim>()));
+  EXPECT_TRUE(std::is_trivially_copyable<dbox>::value);
   ostringstream buf;
   buf << b4;
   EXPECT_EQ("([0,0,0]:[4,4,4])", buf.str());
 }
 
+struct count_boxes {
+  template <int D> std::size_t operator()(const region<int, D> &r) const {
+    return r.boxes.size();
+  }
+};
+struct clear_region {
+  template <int D> void operator()(region<int, D> &r) const {
+    r = region<int, D>();
+  }
+};
+
 TEST(RegionCalculus, dregion) {
   const int dim = 3;
   typedef dpoint<int> dpoint;
@@ -465,6 +794,32 @@ TEST(RegionCalculus, dregion) {
   dregion r12(r12vals);
   vector<dbox> r12boxes = r12;
   EXPECT_EQ(r12vals, r12boxes);
+  EXPECT_EQ(2, r12.visit(count_boxes()));
+  EXPECT_EQ(vector<bool>({true, true, false}),
+            r12.contains(vector<dpoint>{p, p1, p2}));
+  EXPECT_EQ(vector<bool>({false, true}),
+            r12.isdisjoint(vector<dbox>{b2, dbox(p2, dpoint(dim, 3))}));
+  EXPECT_EQ(r2, r1.grow(1).intersection(dregion(dbox(p, dpoint(dim, 4)))));
+  EXPECT_EQ(r, r2.shrink(1));
+  EXPECT_EQ(r1, r2.coarsen(p2));
+  EXPECT_EQ(r2, r1.refine(p2));
+  EXPECT_EQ(dregion(dbox(p1, p2)), r1 >> p1);
+  EXPECT_EQ(dbox(p, p1), b2.coarsen(p2));
+  EXPECT_EQ(b2, b1.refine(p2).grow(dpoint(dim, 0), dpoint(dim, 0)));
+  {
+    const auto pieces = r12.partition(2);
+    EXPECT_EQ(2, pieces.size());
+    EXPECT_EQ(1, pieces[0].size());
+    EXPECT_EQ(r12, pieces[0].setunion(pieces[1]));
+    EXPECT_EQ(vector<std::size_t>({1, 0}),
+              sfc_order(vector<dbox>{dbox(p1, p2), b1}));
+  }
+  {
+    dregion r12copy(r12);
+    r12copy.visit(clear_region());
+    EXPECT_TRUE(r12copy.empty());
+    EXPECT_FALSE(r12.empty());
+  }
   vector<dregion> rs;
   rs.push_back(r);
   rs.push_back(r1);
@@ -2,11 +2,13 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 #include <sstream>
 #include <string>
 
+using std::count;
 using std::ostringstream;
 using std::remove;
 using std::shared_ptr;
@@ -52,6 +54,10 @@ TEST(Project, HDF5) {
     ostringstream buf;
     buf << *p2;
     EXPECT_EQ(orig, buf.str());
+    // Types are shared between the file's attributes and the project
+    EXPECT_TRUE(p2->enumtype.committed());
+    auto type = file.openAttribute("type").getDataType();
+    EXPECT_TRUE(type.committed());
   }
   remove(filename);
 }
@@ -150,6 +156,43 @@ TEST(ParameterValue, HDF5) {
   remove(filename);
 }
 
+TEST(ParameterValue, find) {
+  auto p1 = createProject("p1");
+  auto iteration = p1->createParameter("iteration");
+  auto time = p1->createParameter("time");
+  for (int i = 0; i < 10; ++i) {
+    ostringstream buf;
+    buf << i;
+    auto it = iteration->createParameterValue("iteration." + buf.str());
+    it->setValue(1024 * i);
+    auto t = time->createParameterValue("time." + buf.str());
+    t->setValue(0.5 * i);
+    auto conf = p1->createConfiguration("conf." + buf.str());
+    conf->insertParameterValue(it);
+    conf->insertParameterValue(t);
+  }
+  EXPECT_EQ(iteration->parametervalues.at("iteration.1"),
+            iteration->findParameterValue(1024));
+  EXPECT_FALSE(iteration->findParameterValue(1025));
+  auto its = iteration->findParameterValues(1024, 3 * 1024);
+  EXPECT_EQ(3, its.size());
+  EXPECT_EQ("iteration.3", its.back()->name);
+  EXPECT_TRUE(iteration->findParameterValues(1, 1023).empty());
+  EXPECT_EQ("time.3", time->findNearestParameterValue(1.6)->name);
+  EXPECT_EQ("time.0", time->findNearestParameterValue(-1.0)->name);
+  EXPECT_EQ("time.9", time->findNearestParameterValue(100.0)->name);
+  auto confs = time->findConfigurations(1.0, 1.5);
+  EXPECT_EQ(2, confs.size());
+  EXPECT_EQ("conf.2", confs.front()->name);
+  // Changing a value updates the index
+  iteration->parametervalues.at("iteration.1")->setValue("none");
+  EXPECT_FALSE(iteration->findParameterValue(1024));
+  EXPECT_EQ(2, iteration->findParameterValues(1024, 3 * 1024).size());
+  iteration->parametervalues.at("iteration.1")->setValue(4096);
+  EXPECT_EQ(2, iteration->findParameterValues(4096, 4096).size());
+  EXPECT_EQ(2, iteration->findParameterValues(1024, 3 * 1024).size());
+}
+
 TEST(Configuration, create) {
   EXPECT_TRUE(project->configurations.empty());
   const auto &conf1 = project->createConfiguration("conf1");
@@ -502,6 +545,32 @@ TEST(SubDiscretization, HDF5) {
   remove(filename);
 }
 
+TEST(SubDiscretization, regions) {
+  auto p = createProject("p");
+  auto conf = p->createConfiguration("conf");
+  auto m = p->createManifold("m", conf, 2);
+  auto coarse = m->createDiscretization("coarse", conf);
+  auto fine = m->createDiscretization("fine", conf);
+  auto sd = m->createSubDiscretization("sd", coarse, fine, {2.0, 4.0},
+                                       {1.0, 0.0});
+  const region_t parent_region(box_t(point_t(vector<hssize_t>{0, 0}),
+                                     point_t(vector<hssize_t>{2, 1})));
+  const region_t child_region(box_t(point_t(vector<hssize_t>{-1, 0}),
+                                    point_t(vector<hssize_t>{3, 4})));
+  EXPECT_EQ(child_region, sd->parent2child(parent_region));
+  EXPECT_EQ(parent_region, sd->child2parent(child_region));
+  // The parent footprint covers partially refined parent points
+  const region_t child_part(box_t(point_t(vector<hssize_t>{0, 1}),
+                                  point_t(vector<hssize_t>{2, 2})));
+  EXPECT_EQ(parent_region, sd->child2parent(child_part));
+  // The inverse factors coarsen instead
+  auto sd2 = m->createSubDiscretization("sd2", fine, coarse, {0.5, 0.25},
+                                        {0.0, 0.0});
+  EXPECT_EQ(region_t(box_t(point_t(vector<hssize_t>{0, 0}),
+                           point_t(vector<hssize_t>{2, 1}))),
+            sd2->parent2child(child_region >> point_t(vector<hssize_t>{1, 0})));
+}
+
 TEST(DiscretizationBlock, create) {
   const auto &m1 = project->manifolds.at("m1");
   const auto &d1 = m1->discretizations.at("d1");
@@ -536,6 +605,48 @@ TEST(DiscretizationBlock, HDF5) {
   remove(filename);
 }
 
+TEST(DiscretizationBlock, index) {
+  auto p1 = createProject("p1");
+  auto conf = p1->createConfiguration("conf");
+  auto m = p1->createManifold("m", conf, 2);
+  auto d = m->createDiscretization("d", conf);
+  // A 10 x 10 grid of 4 x 4 blocks, overlapping by one point
+  for (int j = 0; j < 10; ++j)
+    for (int i = 0; i < 10; ++i) {
+      ostringstream buf;
+      buf << "db." << j << "." << i;
+      auto db = d->createDiscretizationBlock(buf.str());
+      db->setRegion(box_t(point_t(vector<hssize_t>{3 * i, 3 * j}),
+                          point_t(vector<hssize_t>{3 * i + 4, 3 * j + 4})));
+    }
+  auto brute_force = [&](const box_t &box) {
+    vector<shared_ptr<DiscretizationBlock>> result;
+    for (const auto &db : d->discretizationblocks)
+      if (!db.second->region.isdisjoint(box))
+        result.push_back(db.second);
+    return result;
+  };
+  for (int j = -2; j < 34; j += 5)
+    for (int i = -2; i < 34; i += 3) {
+      const point_t p(vector<hssize_t>{i, j});
+      const box_t b(p, p + point_t(vector<hssize_t>{1, 1}));
+      EXPECT_EQ(brute_force(b), d->findDiscretizationBlocksContaining(p));
+      const box_t b2(p, p + point_t(vector<hssize_t>{7, 2}));
+      EXPECT_EQ(brute_force(b2), d->findDiscretizationBlocksIntersecting(b2));
+    }
+  const point_t p(vector<hssize_t>{6, 6});
+  EXPECT_EQ(4, d->findDiscretizationBlocksContaining(p).size());
+  // The index is updated when blocks are added or their regions change
+  auto db = d->createDiscretizationBlock("extra");
+  db->setRegion(box_t(p, p + point_t(vector<hssize_t>{1, 1})));
+  EXPECT_EQ(5, d->findDiscretizationBlocksContaining(p).size());
+  db->setRegion(box_t(point_t(vector<hssize_t>{100, 100}),
+                      point_t(vector<hssize_t>{101, 101})));
+  EXPECT_EQ(4, d->findDiscretizationBlocksContaining(p).size());
+  EXPECT_EQ(1, d->findDiscretizationBlocksContaining(
+                    point_t(vector<hssize_t>{100, 100})).size());
+}
+
 TEST(Basis, create) {
   const auto &conf1 = project->configurations.at("conf1");
   const auto &s1 = project->tangentspaces.at("s1");
@@ -631,6 +742,67 @@ TEST(DiscreteField, HDF5) {
   remove(filename);
 }
 
+TEST(DiscreteField, blockOrder) {
+  auto filename = "blockorder.s5";
+  auto p = createProject("p");
+  p->createStandardTensorTypes();
+  const auto &scalar2d = p->tensortypes.at("Scalar2D");
+  auto conf = p->createConfiguration("conf");
+  auto m = p->createManifold("m", conf, 2);
+  auto ts = p->createTangentSpace("ts", conf, 2);
+  auto f = p->createField("f", conf, m, ts, scalar2d);
+  auto d = m->createDiscretization("d", conf);
+  auto df = f->createDiscreteField("df", conf, d, ts->createBasis("b", conf));
+  // Blocks on a 4x4 grid, named in row-major order, and a block without
+  // region
+  const auto create_block = [&](int n) {
+    const string name = string("dfb") + char('a' + n);
+    auto db = d->createDiscretizationBlock(name);
+    if (n < 16)
+      db->setRegion(
+          box_t(point_t(vector<hssize_t>{4 * (n % 4), 4 * (n / 4)}),
+                point_t(vector<hssize_t>{4 * (n % 4) + 4, 4 * (n / 4) + 4})));
+    df->createDiscreteFieldBlock(name, db);
+  };
+  // Blocks are written in their order, so that the object headers of the
+  // blocks with names in [first, last] have increasing addresses
+  const auto check_order = [&](const H5::H5File &file, const string &first,
+                               const string &last) {
+    haddr_t addr = 0;
+    for (const auto &dfb : df->orderedDiscreteFieldBlocks()) {
+      if (dfb->name < first || dfb->name > last)
+        continue;
+      H5O_info_t info;
+      herr_t herr = H5Oget_info_by_name(file.getId(), dfb->getPath().c_str(),
+                                        &info, H5P_DEFAULT);
+      EXPECT_FALSE(herr);
+      EXPECT_LT(addr, info.addr);
+      addr = info.addr;
+    }
+  };
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    for (int n = 0; n < 8; ++n)
+      create_block(n);
+    create_block(16);
+    p->write(file);
+    check_order(file, "dfba", "dfbq");
+    // Appended blocks are written in their order as well
+    for (int n = 8; n < 16; ++n)
+      create_block(n);
+    p->append(file);
+    check_order(file, "dfbi", "dfbp");
+  }
+  const auto blocks = df->orderedDiscreteFieldBlocks();
+  EXPECT_EQ(17, blocks.size());
+  EXPECT_EQ("dfbq", blocks.front()->name);
+  vector<string> names;
+  for (const auto &dfb : blocks)
+    names.push_back(dfb->name);
+  EXPECT_FALSE(std::is_sorted(names.begin(), names.end()));
+  remove(filename);
+}
+
 TEST(CoordinateField, create) {
   const auto &cs1 = project->coordinatesystems.at("cs1");
   const auto &f1 = project->fields.at("f1");
@@ -786,4 +958,532 @@ TEST(DiscreteFieldBlockComponent, HDF5) {
   remove(filename);
 }
 
+TEST(LeanLayout, HDF5) {
+  auto filename = "project_lean.s5";
+  string orig;
+  {
+    project->layout = Project::layout_lean;
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->write(file);
+    project->layout = Project::layout_full;
+    ostringstream buf;
+    buf << *project;
+    orig = buf.str();
+  }
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto group = file.openGroup("fields/f1");
+    EXPECT_FALSE(H5Lexists(group.getLocId(), "project", H5P_DEFAULT));
+    EXPECT_TRUE(H5Lexists(group.getLocId(), "configuration", H5P_DEFAULT));
+    EXPECT_FALSE(H5Lexists(file.getLocId(), "configurations/conf1/fields",
+                           H5P_DEFAULT));
+    auto p2 = readProject(file);
+    EXPECT_EQ(Project::layout_lean, p2->layout);
+    EXPECT_TRUE(p2->invariant());
+    ostringstream buf;
+    buf << *p2;
+    EXPECT_EQ(orig, buf.str());
+    EXPECT_EQ(project->configurations.at("conf1")->fields.size(),
+              p2->configurations.at("conf1")->fields.size());
+  }
+  remove(filename);
+}
+
+TEST(Append, HDF5) {
+  auto filename = "append.s5";
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->write(file);
+  }
+  string orig;
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDWR);
+    auto p1 = readProject(file);
+    const auto &par1 = p1->parameters.at("par1");
+    auto val5 = par1->createParameterValue("val5");
+    val5->setValue(5);
+    auto conf3 = p1->createConfiguration("conf3");
+    conf3->insertParameterValue(val5);
+    const auto &f1 = p1->fields.at("f1");
+    const auto &d1 = f1->manifold->discretizations.at("d1");
+    auto df2 = f1->createDiscreteField("df2", conf3, d1,
+                                       f1->tangentspace->bases.at("b1"));
+    const auto &db1 = d1->discretizationblocks.at("db1");
+    auto dfb2 = df2->createDiscreteFieldBlock("dfb2", db1);
+    dfb2->createDiscreteFieldBlockComponent(
+        "dfbd5", f1->tensortype->tensorcomponents.at("00"));
+    p1->append(file);
+    ostringstream buf;
+    buf << *p1;
+    orig = buf.str();
+  }
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p2 = readProject(file);
+    EXPECT_TRUE(p2->invariant());
+    EXPECT_EQ(1, p2->configurations.at("conf3")->discretefields.size());
+    ostringstream buf;
+    buf << *p2;
+    EXPECT_EQ(orig, buf.str());
+  }
+  remove(filename);
+}
+
+TEST(Invariant, validate) {
+  EXPECT_TRUE(project->validate());
+  EXPECT_TRUE(project->validate(true));
+  const auto level = invariant_level();
+  invariant_level() = invariant_full;
+  auto p1 = createProject("p1");
+  p1->createStandardTensorTypes();
+  EXPECT_TRUE(p1->checkInvariant());
+  EXPECT_TRUE(p1->validate());
+  invariant_level() = level;
+}
+
+TEST(MetadataOnly, HDF5) {
+  auto filename = "metadataonly.s5";
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->write(file);
+  }
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p2 = readProject(file, true);
+    EXPECT_TRUE(p2->invariant());
+    EXPECT_TRUE(p2->open_datasets.empty());
+    const auto &dfbd3 = p2->fields.at("f1")
+                            ->discretefields.at("df1")
+                            ->discretefieldblocks.at("dfb1")
+                            ->discretefieldblockcomponents.at("dfbd3");
+    EXPECT_EQ(DiscreteFieldBlockComponent::type_dataset, dfbd3->data_type);
+    // Output does not open datasets
+    ostringstream buf;
+    buf << *p2;
+    EXPECT_NE(string::npos, buf.str().find("dataset (not opened)"));
+    EXPECT_TRUE(p2->open_datasets.empty());
+    EXPECT_EQ(3, dfbd3->getDataSpace().getSimpleExtentNdims());
+    EXPECT_EQ(1, p2->open_datasets.size());
+    EXPECT_TRUE(H5Iis_valid(dfbd3->getDataSet().getId()) > 0);
+    dfbd3->setData();
+    EXPECT_TRUE(p2->open_datasets.empty());
+  }
+  remove(filename);
+}
+
+TEST(MetadataOnly, datasetPool) {
+  auto filename = "datasetpool.s5";
+  {
+    auto p = createProject("p");
+    p->createStandardTensorTypes();
+    const auto &scalar3d = p->tensortypes.at("Scalar3D");
+    auto conf = p->createConfiguration("conf");
+    auto m = p->createManifold("m", conf, 3);
+    auto ts = p->createTangentSpace("ts", conf, 3);
+    auto f = p->createField("f", conf, m, ts, scalar3d);
+    auto d = m->createDiscretization("d", conf);
+    auto df =
+        f->createDiscreteField("df", conf, d, ts->createBasis("b", conf));
+    for (int n = 0; n < 3; ++n) {
+      auto db = d->createDiscretizationBlock("db" + std::to_string(n));
+      auto dfb = df->createDiscreteFieldBlock("dfb" + std::to_string(n), db);
+      const hsize_t dims[3] = {2, 2, 2};
+      dfb->createDiscreteFieldBlockComponent("scalar",
+                                             scalar3d->storage_indices.at(0))
+          ->setData(H5::getType(0.0), H5::DataSpace(3, dims));
+    }
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    p->write(file);
+  }
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p2 = readProject(file, true);
+    p2->max_open_datasets = 2;
+    const auto &df = p2->fields.at("f")->discretefields.at("df");
+    const auto component = [&](const string &name) {
+      return df->discretefieldblocks.at(name)->discretefieldblockcomponents.at(
+          "scalar");
+    };
+    const auto dfbd0 = component("dfb0");
+    dfbd0->getDataSet();
+    std::weak_ptr<DiscreteFieldBlockComponent> dfbd1 = component("dfb1");
+    dfbd1.lock()->getDataSet();
+    EXPECT_EQ(2, p2->open_datasets.size());
+    // A destroyed component does not count towards the limit
+    df->discretefieldblocks.erase("dfb1");
+    EXPECT_TRUE(dfbd1.expired());
+    component("dfb2")->getDataSet();
+    EXPECT_EQ(2, p2->open_datasets.size());
+    EXPECT_TRUE(H5Iis_valid(dfbd0->data_dataset.getId()) > 0);
+  }
+  remove(filename);
+}
+
+TEST(Streaming, HDF5) {
+  auto filename = "streaming.s5";
+  auto filename2 = "streaming2.s5";
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->write(file);
+  }
+  string orig;
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p1 = readProject(file);
+    auto file2 = H5::H5File(filename2, H5F_ACC_TRUNC);
+    p1->startStreaming(file2);
+    EXPECT_TRUE(p1->streaming());
+    const auto &f1 = p1->fields.at("f1");
+    const auto &d1 = f1->manifold->discretizations.at("d1");
+    // A new configuration is not written until a discrete field needs it
+    auto conf4 = p1->createConfiguration("conf4");
+    auto val4 = p1->parameters.at("par1")->createParameterValue("val4");
+    conf4->insertParameterValue(val4);
+    EXPECT_FALSE(H5::pathExists(file2, "configurations/conf4"));
+    auto df3 = f1->createDiscreteField("df3", conf4, d1,
+                                       f1->tangentspace->bases.at("b1"));
+    EXPECT_TRUE(H5::pathExists(file2, "configurations/conf4"));
+    EXPECT_TRUE(
+        H5::pathExists(file2, "parameters/par1/parametervalues/val4"));
+    EXPECT_TRUE(H5::pathExists(file2, "fields/f1/discretefields/df3"));
+    const auto &db1 = d1->discretizationblocks.at("db1");
+    auto dfb3 = df3->createDiscreteFieldBlock("dfb3", db1);
+    auto dfbd6 = dfb3->createDiscreteFieldBlockComponent(
+        "dfbd6", f1->tensortype->tensorcomponents.at("00"));
+    EXPECT_TRUE(H5::pathExists(file2, dfbd6->getPath()));
+    const hsize_t dims[1] = {10};
+    dfbd6->setData(H5::getType(0.0), H5::DataSpace(1, dims));
+    dfbd6->writeData(vector<double>(10, 1.0));
+    EXPECT_TRUE(H5::pathExists(file2, dfbd6->getPath() + "/data"));
+    // Only the new entities that a block links to are written with it
+    auto conf5 = p1->createConfiguration("conf5");
+    auto db3 = d1->createDiscretizationBlock("db3");
+    auto dfb4 = df3->createDiscreteFieldBlock("dfb4", db3);
+    EXPECT_TRUE(H5::pathExists(file2, dfb4->getPath()));
+    EXPECT_TRUE(H5::pathExists(file2, string("manifolds/") +
+                                          f1->manifold->name +
+                                          "/discretizations/d1/"
+                                          "discretizationblocks/db3"));
+    EXPECT_FALSE(H5::pathExists(file2, "configurations/conf5"));
+    ostringstream buf;
+    buf << *p1;
+    orig = buf.str();
+    df3->releaseDiscreteFieldBlock("dfb3");
+    EXPECT_FALSE(df3->discretefieldblocks.count("dfb3"));
+    p1->finishStreaming();
+    EXPECT_FALSE(p1->streaming());
+  }
+  {
+    auto file2 = H5::H5File(filename2, H5F_ACC_RDONLY);
+    auto p2 = readProject(file2);
+    EXPECT_TRUE(p2->invariant());
+    ostringstream buf;
+    buf << *p2;
+    EXPECT_EQ(orig, buf.str());
+    const auto &dfbd6 = p2->fields.at("f1")
+                            ->discretefields.at("df3")
+                            ->discretefieldblocks.at("dfb3")
+                            ->discretefieldblockcomponents.at("dfbd6");
+    EXPECT_EQ(DiscreteFieldBlockComponent::type_dataset, dfbd6->data_type);
+  }
+  remove(filename);
+  remove(filename2);
+}
+
+TEST(Dirty, writeIncremental) {
+  auto filename = "incremental.s5";
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->write(file);
+  }
+  EXPECT_FALSE(project->dirty);
+  string orig;
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDWR);
+    auto p1 = readProject(file);
+    EXPECT_FALSE(p1->dirty);
+    EXPECT_FALSE(p1->configurations.at("conf1")->dirty);
+    const auto &par1 = p1->parameters.at("par1");
+    const auto &val1 = par1->parametervalues.at("val1");
+    val1->setValue(1.5);
+    EXPECT_TRUE(val1->dirty);
+    EXPECT_TRUE(par1->dirty);
+    EXPECT_TRUE(p1->dirty);
+    EXPECT_FALSE(p1->tensortypes.at("Scalar3D")->dirty);
+    const auto &d1 = p1->manifolds.at("m1")->discretizations.at("d1");
+    auto db2 = d1->createDiscretizationBlock("db2");
+    db2->setRegion(box_t(vector<hssize_t>(3, 0), vector<hssize_t>(3, 2)));
+    auto conf5 = p1->createConfiguration("conf5");
+    conf5->insertParameterValue(val1);
+    p1->writeIncremental(file);
+    EXPECT_FALSE(p1->dirty);
+    EXPECT_FALSE(val1->dirty);
+    EXPECT_FALSE(db2->dirty);
+    // Modify entities that have already been written
+    db2->setRegion(box_t(vector<hssize_t>(3, 1), vector<hssize_t>(3, 3)));
+    const auto &val2 = p1->parameters.at("par2")->parametervalues.at("val2");
+    conf5->insertParameterValue(val2);
+    EXPECT_TRUE(conf5->dirty);
+    p1->writeIncremental(file);
+    ostringstream buf;
+    buf << *p1;
+    orig = buf.str();
+  }
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p2 = readProject(file);
+    EXPECT_TRUE(p2->invariant());
+    EXPECT_EQ(2, p2->configurations.at("conf5")->parametervalues.size());
+    ostringstream buf;
+    buf << *p2;
+    EXPECT_EQ(orig, buf.str());
+  }
+  remove(filename);
+}
+
+TEST(Split, HDF5) {
+  auto filename = "split.s5";
+  auto datafilename = "split.conf1.s5";
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->split = Project::split_configuration;
+    project->write(file);
+    project->split = Project::split_none;
+  }
+  EXPECT_GT(H5Fis_hdf5(datafilename), 0);
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p2 = readProject(file);
+    EXPECT_TRUE(p2->invariant());
+    const auto &dfbd3 = p2->fields.at("f1")
+                            ->discretefields.at("df1")
+                            ->discretefieldblocks.at("dfb1")
+                            ->discretefieldblockcomponents.at("dfbd3");
+    EXPECT_EQ(DiscreteFieldBlockComponent::type_extlink, dfbd3->data_type);
+    EXPECT_EQ(datafilename, dfbd3->data_extlink_filename);
+    EXPECT_EQ(dfbd3->getPath(), dfbd3->data_extlink_objname);
+    auto datafile = H5::H5File(datafilename, H5F_ACC_RDONLY);
+    auto dataset = datafile.openDataSet(dfbd3->getPath());
+    EXPECT_EQ(3, dataset.getSpace().getSimpleExtentNdims());
+  }
+  remove(filename);
+  remove(datafilename);
+}
+
+TEST(Lookup, paths) {
+  auto filename = "lookup.s5";
+  auto filename2 = "lookup2.s5";
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    project->write(file);
+  }
+  {
+    auto file = H5::H5File(filename, H5F_ACC_RDONLY);
+    auto p1 = readProject(file);
+    const auto &f1 = p1->fields.at("f1");
+    const auto &df1 = f1->discretefields.at("df1");
+    const auto &dfb1 = df1->discretefieldblocks.at("dfb1");
+    const auto &dfbd3 = dfb1->discretefieldblockcomponents.at("dfbd3");
+    EXPECT_EQ(f1, p1->lookup("fields/f1"));
+    EXPECT_EQ(df1, p1->lookup<DiscreteField>(df1->getPath()));
+    EXPECT_EQ(dfb1, p1->lookup<DiscreteFieldBlock>(dfb1->getPath()));
+    EXPECT_EQ(dfbd3,
+              p1->lookup<DiscreteFieldBlockComponent>(dfbd3->getPath()));
+    EXPECT_EQ(p1->parameters.at("par1")->parametervalues.at("val1"),
+              p1->lookup("parameters/par1/parametervalues/val1"));
+    EXPECT_EQ(p1->tensortypes.at("Scalar3D"),
+              p1->lookup<TensorType>("tensortypes/Scalar3D"));
+    EXPECT_FALSE(p1->lookup<Field>("tensortypes/Scalar3D"));
+    EXPECT_FALSE(p1->lookup("fields/nonexistent"));
+    // Entities created after the index has been built are found as well
+    auto dfbd7 = dfb1->createDiscreteFieldBlockComponent(
+        "dfbd7", f1->tensortype->tensorcomponents.at("12"));
+    EXPECT_EQ(dfbd7, p1->lookup(dfbd7->getPath()));
+    // Released entities are removed from the index
+    auto file2 = H5::H5File(filename2, H5F_ACC_TRUNC);
+    p1->startStreaming(file2);
+    const auto dfb1path = dfb1->getPath();
+    const auto dfbd7path = dfbd7->getPath();
+    dfbd7.reset();
+    df1->releaseDiscreteFieldBlock("dfb1");
+    EXPECT_FALSE(p1->lookup(dfb1path));
+    EXPECT_FALSE(p1->lookup(dfbd7path));
+    EXPECT_EQ(df1, p1->lookup(df1->getPath()));
+    p1->finishStreaming();
+  }
+  remove(filename);
+  remove(filename2);
+}
+
+TEST(Selection, query) {
+  const auto &f1 = project->fields.at("f1");
+  const auto &df1 = f1->discretefields.at("df1");
+  const auto &dfb1 = df1->discretefieldblocks.at("dfb1");
+  const auto &dfbd1 = dfb1->discretefieldblockcomponents.at("dfbd1");
+  auto dfs =
+      project->select().field("f*").discretization("d1").discretefields();
+  EXPECT_EQ(1, count(dfs.begin(), dfs.end(), df1));
+  EXPECT_TRUE(project->select().field("g*").discretefields().empty());
+  dfs = project->select().configuration("conf1").discretefields();
+  EXPECT_EQ(1, count(dfs.begin(), dfs.end(), df1));
+  EXPECT_TRUE(
+      project->select().configuration("conf2").discretefields().empty());
+  // conf2 is the only configuration with a value for par1
+  EXPECT_TRUE(
+      project->select().parameter("par1", 0, 2).discretefields().empty());
+  EXPECT_TRUE(project->select().discretization("d2").discretefields().empty());
+  // db1 covers [3,9) x [3,10) x [3,11)
+  auto dfbs = project->select()
+                  .field("f1")
+                  .intersects(box_t(point_t(vector<hssize_t>(3, 8)),
+                                    point_t(vector<hssize_t>(3, 12))))
+                  .discretefieldblocks();
+  EXPECT_EQ(1, count(dfbs.begin(), dfbs.end(), dfb1));
+  dfbs = project->select()
+             .field("f1")
+             .intersects(box_t(point_t(vector<hssize_t>(3, 0)),
+                               point_t(vector<hssize_t>(3, 3))))
+             .discretefieldblocks();
+  EXPECT_EQ(0, count(dfbs.begin(), dfbs.end(), dfb1));
+  auto dfbcs = project->select()
+                   .field("f1")
+                   .tensorcomponent(dfbd1->tensorcomponent->name)
+                   .components();
+  EXPECT_EQ(1, count(dfbcs.begin(), dfbcs.end(), dfbd1));
+  for (const auto &dfbc : dfbcs)
+    EXPECT_EQ(dfbd1->tensorcomponent, dfbc->tensorcomponent);
+}
+
+TEST(DataCopy, memory) {
+  typedef RegionCalculus::point<hssize_t, 2> point2;
+  typedef RegionCalculus::box<hssize_t, 2> box2;
+  // Two sources, the second with an active region
+  const box2 region0(point2(0, 0), point2(4, 4));
+  const box2 region1(point2(4, 0), point2(8, 4));
+  const box2 active1(point2(4, 0), point2(6, 4));
+  vector<int> data0, data1;
+  for (int idx = 0; idx < 16; ++idx) {
+    data0.push_back(idx);
+    data1.push_back(100 + idx);
+  }
+  vector<BlockData<int>> sources;
+  sources.push_back({region0, region_t(), data0.data()});
+  sources.push_back({region1, region_t(active1), data1.data()});
+  const box2 dest(point2(2, 1), point2(7, 3));
+  for (const bool parallel : {false, true}) {
+    vector<int> dest_data(dest.size(), -1);
+    copyData(sources, dest, dest_data.data(), parallel);
+    for (int j = 1; j < 3; ++j)
+      for (int i = 2; i < 7; ++i) {
+        const int idx = (i - 2) + 5 * (j - 1);
+        const int expected =
+            i < 4 ? i + 4 * j : i < 6 ? 100 + (i - 4) + 4 * j : -1;
+        EXPECT_EQ(expected, dest_data.at(idx));
+      }
+  }
+}
+
+TEST(DataCopy, HDF5) {
+  auto filename = "datacopy.s5";
+  auto p = createProject("p");
+  p->createStandardTensorTypes();
+  const auto &scalar3d = p->tensortypes.at("Scalar3D");
+  auto conf = p->createConfiguration("conf");
+  auto m = p->createManifold("m", conf, 3);
+  auto ts = p->createTangentSpace("ts", conf, 3);
+  auto f = p->createField("f", conf, m, ts, scalar3d);
+  auto d = m->createDiscretization("d", conf);
+  auto df = f->createDiscreteField("df", conf, d, ts->createBasis("b", conf));
+  const box_t regions[2] = {
+      box_t(point_t(vector<hssize_t>{0, 0, 0}),
+            point_t(vector<hssize_t>{4, 4, 4})),
+      box_t(point_t(vector<hssize_t>{4, 0, 0}),
+            point_t(vector<hssize_t>{8, 4, 4}))};
+  vector<shared_ptr<DiscreteFieldBlockComponent>> components;
+  for (int n = 0; n < 2; ++n) {
+    auto db = d->createDiscretizationBlock("db" + std::to_string(n));
+    db->setRegion(regions[n]);
+    auto dfb = df->createDiscreteFieldBlock("dfb" + std::to_string(n), db);
+    components.push_back(dfb->createDiscreteFieldBlockComponent(
+        "scalar", scalar3d->storage_indices.at(0)));
+    const hsize_t dims[3] = {4, 4, 4};
+    components.back()->setData(H5::getType(0.0), H5::DataSpace(3, dims));
+  }
+  // Only the lowest plane of the second block is active
+  components[1]->discretefieldblock.lock()->discretizationblock->setActive(
+      region_t(box_t(point_t(vector<hssize_t>{4, 0, 0}),
+                     point_t(vector<hssize_t>{5, 4, 4}))));
+  const auto check_copy =
+      [](const vector<shared_ptr<DiscreteFieldBlockComponent>> &sources) {
+        const box_t dest(point_t(vector<hssize_t>{2, 1, 0}),
+                         point_t(vector<hssize_t>{6, 3, 4}));
+        vector<double> dest_data(dest.size(), -1.0);
+        copyData(sources, dest, dest_data.data());
+        for (int k = 0; k < 4; ++k)
+          for (int j = 1; j < 3; ++j)
+            for (int i = 2; i < 6; ++i) {
+              const int idx = (i - 2) + 4 * ((j - 1) + 2 * k);
+              const double expected = i < 5 ? i + 10 * j + 100 * k : -1.0;
+              EXPECT_EQ(expected, dest_data.at(idx));
+            }
+      };
+  {
+    auto file = H5::H5File(filename, H5F_ACC_TRUNC);
+    p->write(file);
+    for (int n = 0; n < 2; ++n) {
+      vector<double> data;
+      for (int k = 0; k < 4; ++k)
+        for (int j = 0; j < 4; ++j)
+          for (int i = 0; i < 4; ++i)
+            data.push_back(i + 4 * n + 10 * j + 100 * k);
+      components[n]->writeData(data);
+    }
+    check_copy(components);
+    // Components without a dataset are skipped
+    auto db = d->createDiscretizationBlock("db-empty");
+    db->setRegion(box_t(point_t(vector<hssize_t>{5, 0, 0}),
+                        point_t(vector<hssize_t>{8, 4, 4})));
+    auto empty = df->createDiscreteFieldBlock("dfb-empty", db)
+                     ->createDiscreteFieldBlockComponent(
+                         "scalar", scalar3d->storage_indices.at(0));
+    auto sources = components;
+    sources.push_back(empty);
+    check_copy(sources);
+  }
+  remove(filename);
+
+  // Copy from split output that has been read back, where the components
+  // are external links into the data file
+  auto splitfilename = "datacopy-split.s5";
+  auto datafilename = "datacopy-split.conf.s5";
+  {
+    auto file = H5::H5File(splitfilename, H5F_ACC_TRUNC);
+    p->split = Project::split_configuration;
+    p->write(file);
+    for (int n = 0; n < 2; ++n) {
+      vector<double> data;
+      for (int k = 0; k < 4; ++k)
+        for (int j = 0; j < 4; ++j)
+          for (int i = 0; i < 4; ++i)
+            data.push_back(i + 4 * n + 10 * j + 100 * k);
+      components[n]->writeData(data);
+    }
+  }
+  for (const bool metadata_only : {false, true}) {
+    auto file = H5::H5File(splitfilename, H5F_ACC_RDONLY);
+    auto p2 = readProject(file, metadata_only);
+    const auto &df2 = p2->fields.at("f")->discretefields.at("df");
+    vector<shared_ptr<DiscreteFieldBlockComponent>> sources;
+    for (int n = 0; n < 2; ++n) {
+      const auto &dfbd = df2->discretefieldblocks.at("dfb" + std::to_string(n))
+                             ->discretefieldblockcomponents.at("scalar");
+      EXPECT_EQ(DiscreteFieldBlockComponent::type_extlink, dfbd->data_type);
+      sources.push_back(dfbd);
+    }
+    check_copy(sources);
+  }
+  remove(splitfilename);
+  remove(datafilename);
+}
+
 #include "src/gtest_main.cc"